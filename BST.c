@@ -6,226 +6,1465 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "BST.h"
 #include "List.h"
+#include "Eytzinger.h"
+
+// number of searches advanced together by bstSearchInterleaved
+#define SEARCH_LANES 16
+
+// distance, in levels of the frozen array, of the prefetched descendants
+// (2^3 pointers fill a cache line)
+#define FROZEN_AHEAD 8
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+// index standing for no node: the slot 0 of the array of the nodes is a
+// zeroed node (black, of size 0) that never belongs to the tree
+#define NIL 0
+
+// number of slots of the array of the nodes that the parent links can
+// address (their 32 bits also hold the color of the node)
+#define MAX_NODES ((((size_t)1) << 31) - 1)
+
+// number of elements that the 32-bit subtree sizes can count
+#define MAX_ELEMENTS ((size_t)UINT32_MAX)
 
 /* Opaque Structure */
 
 typedef struct BNode_t BNode;
 
+// the nodes are addressed by their index in the array of their tree, which
+// takes half the size of a pointer
+typedef uint32_t NodeIndex;
+
+typedef enum
+{
+    BLACK,
+    RED
+} Color;
+
+typedef struct Entry_t Entry;
+
+struct Entry_t
+{
+    void *key;
+    void *value;
+};
+
+typedef struct Bucket_t Bucket;
+
+// the elements of a node beyond the first one, whose keys are all equal to
+// the key of the node
+struct Bucket_t
+{
+    size_t size;
+    size_t capacity;
+    Entry entries[];
+};
+
+// 32 bytes: the color is packed with the parent link, and the buckets of
+// duplicate keys are kept out of the nodes (see BST_t)
 struct BNode_t
 {
-    BNode *parent;
-    BNode *left;
-    BNode *right;
+    NodeIndex left;
+    NodeIndex right;
+    unsigned int parent : 31;
+    unsigned int color : 1;
+    uint32_t size; // number of elements in the subtree rooted at this node
     void *key;
     void *value;
 };
 
+struct BSTCursor_t
+{
+    BST *bst;
+    NodeIndex node; // node of the next element (NIL once the range is over)
+    size_t index; // index of the next element in its node
+    size_t slot;  // frozen trees: slot of the next element (0 when over)
+    void *keyMax;
+};
+
 struct BST_t
 {
-    BNode *root;
+    NodeIndex root;
     size_t size;
+    size_t nnodes; // number of nodes, i.e. of distinct keys
     int (*compfn)(void *, void *);
+    // storage of the nodes, whose slot 0 is the NIL node. The array may be
+    // moved when it grows, so the nodes are linked by their indices.
+    BNode *nodes;
+    size_t capacity; // number of slots of nodes
+    size_t used; // number of slots taken so far, released ones included
+    NodeIndex released; // first released slot, the next ones being linked
+                        // through their right field (NIL if none)
+    // other elements with the same key as each node (NULL if none), as many
+    // slots as nodes. Few keys are duplicated: the array is only allocated
+    // with the first bucket (NULL until then).
+    Bucket **dups;
+    // frozen trees: every element in Eytzinger (BFS) order, the children of
+    // slot k being 2k and 2k + 1, slot 0 being unused (NULL if not frozen)
+    void **frozenKeys;
+    void **frozenValues;
 };
 
 /* Prototypes of static functions */
 
-static void bstFreeRec(BNode *n, bool freeKey, bool freeValue);
-static BNode *bnNew(void *key, void *value);
+/* ------------------------------------------------------------------------- *
+ * Frees the keys and/or the values of the nodes of a BST, and the buckets
+ * of duplicate keys (the nodes belong to the array of the tree).
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * freeKey      Whether to free the keys.
+ * freeValue    Whether to free the values.
+ *
+ * ------------------------------------------------------------------------- */
+static void bstFreeNodes(BST *bst, bool freeKey, bool freeValue);
+
+/* ------------------------------------------------------------------------- *
+ * Grows the array of the nodes of a BST, if needed, so that n nodes can be
+ * created without moving it.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            The number of nodes to make room for.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error, or if
+ *              the nodes would not be addressable with 32-bit indices.
+ * ------------------------------------------------------------------------- */
+static bool nodesReserve(BST *bst, size_t n);
+
+/* ------------------------------------------------------------------------- *
+ * Creates a new red node, in a released slot or in a slot reserved by
+ * nodesReserve() (the array of the nodes does not move).
+ *
+ * PARAMETERS
+ * bst          A valid pointer to the BST the node is created for.
+ * key          The key of the node.
+ * value        The value of the node.
+ *
+ * RETURN
+ * i            The index of the node.
+ * ------------------------------------------------------------------------- */
+static NodeIndex bnNew(BST *bst, void *key, void *value);
+
+/* ------------------------------------------------------------------------- *
+ * Gives the slot of a node back to its BST, for a later bnNew().
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * i            The index of a node of bst that is not linked anymore.
+ *
+ * ------------------------------------------------------------------------- */
+static void bnRelease(BST *bst, NodeIndex i);
+
+/* ------------------------------------------------------------------------- *
+ * Performs a left rotation around the node x. The right child of x takes
+ * its place and x becomes its left child. The in-order sequence of the keys
+ * is preserved.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * x            A node of bst with a right child.
+ *
+ * ------------------------------------------------------------------------- */
+static void leftRotate(BST *bst, NodeIndex x);
+
+/* ------------------------------------------------------------------------- *
+ * Performs a right rotation around the node x. The left child of x takes
+ * its place and x becomes its right child. The in-order sequence of the keys
+ * is preserved.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * x            A node of bst with a left child.
+ *
+ * ------------------------------------------------------------------------- */
+static void rightRotate(BST *bst, NodeIndex x);
+
+/* ------------------------------------------------------------------------- *
+ * Restores the red-black properties after the insertion of the red node z,
+ * so that the height of the tree stays in O(log n).
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * z            The node that was just inserted.
+ *
+ * ------------------------------------------------------------------------- */
+static void bstInsertFixup(BST *bst, NodeIndex z);
+
+/* ------------------------------------------------------------------------- *
+ * Replaces the subtree rooted at u by the subtree rooted at v in the parent
+ * of u.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * u            A node of bst.
+ * v            A node of bst (possibly NIL).
+ *
+ * ------------------------------------------------------------------------- */
+static void transplant(BST *bst, NodeIndex u, NodeIndex v);
+
+/* ------------------------------------------------------------------------- *
+ * Restores the red-black properties after the removal of a black node, x
+ * being the subtree that lost one black node on its paths.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * x            The node taking the place of the removed one (possibly NIL).
+ * xParent      The parent of x (x may be NIL).
+ *
+ * ------------------------------------------------------------------------- */
+static void bstRemoveFixup(BST *bst, NodeIndex x, NodeIndex xParent);
+
+/* ------------------------------------------------------------------------- *
+ * Returns the number of elements in the subtree rooted at n.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            A node of bst (possibly NIL).
+ *
+ * RETURN
+ * size         The size of the subtree (0 if n is NIL).
+ * ------------------------------------------------------------------------- */
+static size_t nodeSize(BST *bst, NodeIndex n);
+
+/* ------------------------------------------------------------------------- *
+ * Returns the bucket of the elements of a node beyond its own one.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            A node of bst.
+ *
+ * RETURN
+ * b            The bucket of n, or NULL if n holds a single element.
+ * ------------------------------------------------------------------------- */
+static Bucket *nodeDups(BST *bst, NodeIndex n);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the elements held by a node (its own and those of its bucket).
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            A node of bst.
+ *
+ * RETURN
+ * nb           The number of elements of the node.
+ * ------------------------------------------------------------------------- */
+static size_t nodeCount(BST *bst, NodeIndex n);
+
+/* ------------------------------------------------------------------------- *
+ * Adds an element to the bucket of a node, whose key is equal to the key
+ * of the node.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            A node of bst.
+ * key          The key of the element.
+ * value        The value of the element.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool bucketAppend(BST *bst, NodeIndex n, void *key, void *value);
+
+/* ------------------------------------------------------------------------- *
+ * Gives the key and the value of the i-th element of a node.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            A node of bst.
+ * i            The index of the element (0 for the own element of the node,
+ *              1 to nodeCount(n) - 1 for the elements of its bucket).
+ * key          If not NULL, set to the key of the element.
+ * value        If not NULL, set to the value of the element.
+ *
+ * ------------------------------------------------------------------------- */
+static void nodeElement(BST *bst, NodeIndex n, size_t i, void **key,
+                        void **value);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the keys of the BST that are smaller than a given key (or smaller
+ * than or equal to it), using the subtree sizes along a single descent.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * key          The key to compare to.
+ * orEqual      Whether the keys equal to key are counted as well.
+ *
+ * RETURN
+ * nb           The number of keys < key (or <= key).
+ * ------------------------------------------------------------------------- */
+static size_t countBelow(BST *bst, void *key, bool orEqual);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the element of a given in-order rank in the subtree rooted at n,
+ * using the subtree sizes along a single descent.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            A node of bst (possibly NIL).
+ * i            The rank of the element in the subtree (starting at 0), set
+ *              to the index of the element in its node (see nodeElement).
+ *
+ * RETURN
+ * n            The node holding the element of rank i, or NIL if i >= the
+ *              size of the subtree.
+ * ------------------------------------------------------------------------- */
+static NodeIndex nodeSelect(BST *bst, NodeIndex n, size_t *i);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the node following a given one in the in-order sequence.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            A node of bst.
+ *
+ * RETURN
+ * s            The successor of n, or NIL if n is the last node.
+ * ------------------------------------------------------------------------- */
+static NodeIndex nodeSuccessor(BST *bst, NodeIndex n);
+
+/* ------------------------------------------------------------------------- *
+ * Resolves a sorted batch of queries in the subtree rooted at a given node.
+ * The queries equal to the key of the node are answered there, and those
+ * on both sides are passed down as two groups, so each node is read once
+ * per batch whatever the number of queries reaching it.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n            The root of the subtree (may be NIL).
+ * queries      The queries, sorted by increasing keys, each value being the
+ *              address where the result is written (void **).
+ * m            The number of queries.
+ *
+ * ------------------------------------------------------------------------- */
+static void searchBatchRec(BST *bst, NodeIndex n, Entry *queries, size_t m);
+
+/* ------------------------------------------------------------------------- *
+ * Frees the frozen arrays of a BST, before it is modified.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ *
+ * ------------------------------------------------------------------------- */
+static void bstThaw(BST *bst);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the first element of a frozen BST whose key is greater than or
+ * equal to a given key. The descent has no branch depending on the keys,
+ * and prefetches the descendants a few levels below.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a frozen BST object.
+ * key          The key to look for.
+ *
+ * RETURN
+ * k            The slot of that element, or 0 if all keys are smaller.
+ * ------------------------------------------------------------------------- */
+static size_t frozenLowerBound(BST *bst, void *key);
+
+/* ------------------------------------------------------------------------- *
+ * Sorts an array of entries by increasing keys (stable merge sort).
+ *
+ * PARAMETERS
+ * compfn       The comparison function of the keys.
+ * entries      The array to sort.
+ * tmp          A buffer of (at least) n entries.
+ * n            The number of entries.
+ *
+ * ------------------------------------------------------------------------- */
+static void entriesSort(int (*compfn)(void *, void *), Entry *entries,
+                        Entry *tmp, size_t n);
+
+/* ------------------------------------------------------------------------- *
+ * Builds a minimum-height subtree from a sorted array of entries, grouped
+ * by equal keys, the median group being the root. Nodes on the deepest
+ * level are colored red when this level is incomplete, all the others are
+ * black, so that the result is a valid red-black tree.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to the BST the nodes are created for (with
+ *              room for n nodes, see nodesReserve).
+ * entries      The sorted entries.
+ * starts       The index in entries of the first entry of each group of
+ *              the subtree, followed by the end of the last group.
+ * n            The number of groups.
+ * depth        The depth of the root of the subtree.
+ * redDepth     The depth at which the nodes must be red.
+ * error        Set to true in case of allocation error.
+ *
+ * RETURN
+ * n            The root of the subtree (NIL if n = 0).
+ * ------------------------------------------------------------------------- */
+static NodeIndex bstBuildRec(BST *bst, Entry *entries, size_t *starts,
+                             size_t n, size_t depth, size_t redDepth,
+                             bool *error);
+
+
+/* Function definitions */
+
+/* ------------------------------------------------------------------------- *
+ * Finds the node following a given one in a preorder walk of the tree,
+ * using the parent links instead of a stack, so that the walks of the
+ * whole tree do not depend on its height.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object.
+ * n          	A node of bst.
+ * depth		The depth of n, updated with the depth of the next node.
+ *
+ * RETURN
+ * next			The next node, or NIL if n is the last one.
+ * ------------------------------------------------------------------------- */
+static NodeIndex preorderNext(BST *bst, NodeIndex n, size_t *depth);
+
+/* ------------------------------------------------------------------------- *
+ * Positions a cursor before the first element of a range.
+ *
+ * PARAMETERS
+ * c            A valid pointer to the cursor to initialise.
+ * bst          A valid pointer to a BST object.
+ * keymin		Lower bound of the range (inclusive).
+ * keymax		Upper bound of the range (inclusive).
+ *
+ * ------------------------------------------------------------------------- */
+static void cursorInit(BSTCursor *c, BST *bst, void *keymin, void *keymax);
+
+/* ------------------------------------------------------------------------- *
+ * Inserts a value at the end of a list (callback of bstRangeVisit used by
+ * bstRangeSearch).
+ *
+ * PARAMETERS
+ * key          The key of the element (unused).
+ * value        The value to insert.
+ * l            A valid pointer to a list object.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool collect(void *key, void *value, void *l);
+
+bool nodesReserve(BST *bst, size_t n)
+{
+    if (n <= bst->capacity - bst->used)
+        return true;
+    if (n > MAX_NODES - bst->used)
+    {
+        printf("nodesReserve: too many nodes\n");
+        return false;
+    }
+    // the array grows by half of its size, within the reach of the indices
+    size_t capacity = bst->capacity + bst->capacity / 2;
+    if (capacity < bst->used + n)
+        capacity = bst->used + n;
+    if (capacity > MAX_NODES)
+        capacity = MAX_NODES;
+    if (bst->dups != NULL)
+    {
+        Bucket **dups = realloc(bst->dups, capacity * sizeof(Bucket *));
+        if (dups == NULL)
+        {
+            printf("nodesReserve: allocation error\n");
+            return false;
+        }
+        for (size_t i = bst->capacity; i < capacity; i++)
+            dups[i] = NULL;
+        bst->dups = dups;
+    }
+    BNode *nodes = realloc(bst->nodes, capacity * sizeof(BNode));
+    if (nodes == NULL)
+    {
+        printf("nodesReserve: allocation error\n");
+        return false;
+    }
+    bst->nodes = nodes;
+    bst->capacity = capacity;
+    return true;
+}
+
+NodeIndex bnNew(BST *bst, void *key, void *value)
+{
+    NodeIndex i = bst->released;
+    if (i != NIL)
+        bst->released = bst->nodes[i].right;
+    else
+        i = (NodeIndex)bst->used++;
+    BNode *n = &bst->nodes[i];
+    n->parent = NIL;
+    n->left = NIL;
+    n->right = NIL;
+    n->key = key;
+    n->value = value;
+    n->color = RED;
+    n->size = 1;
+    return i;
+}
+
+void bnRelease(BST *bst, NodeIndex i)
+{
+    bst->nodes[i].right = bst->released;
+    bst->released = i;
+}
+
+BST *bstNew(int comparison_fn_t(void *, void *))
+{
+    BST *bst = malloc(sizeof(BST));
+    if (bst == NULL)
+    {
+        printf("bestNew: allocation error");
+        return NULL;
+    }
+    bst->nodes = calloc(1, sizeof(BNode)); // the NIL node
+    if (bst->nodes == NULL)
+    {
+        printf("bstNew: allocation error\n");
+        free(bst);
+        return NULL;
+    }
+    bst->capacity = 1;
+    bst->used = 1;
+    bst->released = NIL;
+    bst->root = NIL;
+    bst->size = 0;
+    bst->nnodes = 0;
+    bst->compfn = comparison_fn_t;
+    bst->dups = NULL;
+    bst->frozenKeys = NULL;
+    bst->frozenValues = NULL;
+    return bst;
+}
+
+void entriesSort(int (*compfn)(void *, void *), Entry *entries, Entry *tmp,
+                 size_t n)
+{
+    if (n < 2)
+        return;
+    size_t half = n / 2;
+    entriesSort(compfn, entries, tmp, half);
+    entriesSort(compfn, entries + half, tmp, n - half);
+
+    // merge both halves in tmp, taking from the left one on ties
+    size_t i = 0, j = half, k = 0;
+    while (i < half && j < n)
+    {
+        if (compfn(entries[j].key, entries[i].key) < 0)
+            tmp[k++] = entries[j++];
+        else
+            tmp[k++] = entries[i++];
+    }
+    while (i < half)
+        tmp[k++] = entries[i++];
+    while (j < n)
+        tmp[k++] = entries[j++];
+    for (k = 0; k < n; k++)
+        entries[k] = tmp[k];
+}
+
+NodeIndex bstBuildRec(BST *bst, Entry *entries, size_t *starts, size_t n,
+                      size_t depth, size_t redDepth, bool *error)
+{
+    if (n == 0 || *error)
+        return NIL;
+    size_t mid = n / 2;
+    Entry *group = entries + starts[mid];
+    NodeIndex i = bnNew(bst, group[0].key, group[0].value);
+    BNode *node = &bst->nodes[i];
+    for (size_t j = starts[mid] + 1; j < starts[mid + 1]; j++)
+    {
+        if (!bucketAppend(bst, i, entries[j].key, entries[j].value))
+        {
+            *error = true;
+            return NIL;
+        }
+    }
+    node->color = (depth == redDepth) ? RED : BLACK;
+    node->left = bstBuildRec(bst, entries, starts, mid, depth + 1, redDepth,
+                             error);
+    node->right = bstBuildRec(bst, entries, starts + mid + 1, n - mid - 1,
+                              depth + 1, redDepth, error);
+    node->size = starts[n] - starts[0];
+    if (node->left != NIL)
+        bst->nodes[node->left].parent = i;
+    if (node->right != NIL)
+        bst->nodes[node->right].parent = i;
+    return i;
+}
+
+BST *bstBuildFromArrays(int comparison_fn_t(void *, void *), void **keys,
+                        void **values, size_t n)
+{
+    if (n > MAX_ELEMENTS)
+    {
+        printf("bstBuildFromArrays: too many elements\n");
+        return NULL;
+    }
+    BST *bst = bstNew(comparison_fn_t);
+    if (bst == NULL)
+        return NULL;
+    if (n == 0)
+        return bst;
+
+    Entry *entries = malloc(2 * n * sizeof(Entry));
+    size_t *starts = malloc((n + 1) * sizeof(size_t));
+    if (entries == NULL || starts == NULL)
+    {
+        printf("bstBuildFromArrays: allocation error\n");
+        free(entries);
+        free(starts);
+        bstFree(bst, false, false);
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        entries[i].key = keys[i];
+        entries[i].value = values[i];
+    }
+    entriesSort(comparison_fn_t, entries, entries + n, n);
+
+    // one node per group of equal keys
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i == 0 || comparison_fn_t(entries[i - 1].key, entries[i].key) != 0)
+            starts[m++] = i;
+    }
+    starts[m] = n;
+
+    // the deepest level of a minimum-height tree is at depth floor(log2(m)),
+    // it is colored red unless it is full (m = 2^(h+1) - 1)
+    size_t height = 0;
+    while ((((size_t)2) << height) <= m)
+        height++;
+    size_t redDepth = (m == (((size_t)2) << height) - 1) ? height + 1 : height;
+
+    // the array of the nodes is sized once, and filled in preorder
+    bool error = !nodesReserve(bst, m);
+    bst->root = bstBuildRec(bst, entries, starts, m, 0, redDepth, &error);
+    free(entries);
+    free(starts);
+    bst->size = n;
+    bst->nnodes = m;
+    if (error)
+    {
+        bstFree(bst, false, false);
+        return NULL;
+    }
+    return bst;
+}
+
+void bstFree(BST *bst, bool freeKey, bool freeValue)
+{
+    // the nodes themselves are released with their array, the tree only
+    // needs to be walked when keys or values are owned, or to free the
+    // buckets of duplicate keys
+    if (freeKey || freeValue || bst->size != bst->nnodes)
+        bstFreeNodes(bst, freeKey, freeValue);
+    bstThaw(bst);
+    free(bst->dups);
+    free(bst->nodes);
+    free(bst);
+}
+
+bool bstFreeze(BST *bst)
+{
+    bstThaw(bst);
+    size_t n = bst->size;
+    void **keys = malloc((n + 1) * sizeof(void *));
+    void **values = malloc((n + 1) * sizeof(void *));
+    if (keys == NULL || values == NULL)
+    {
+        printf("bstFreeze: allocation error\n");
+        free(keys);
+        free(values);
+        return false;
+    }
+    keys[0] = values[0] = NULL;
+
+    // the in-order walks of the tree and of the array go together
+    NodeIndex node = bst->root;
+    while (node != NIL && bst->nodes[node].left != NIL)
+        node = bst->nodes[node].left;
+    size_t index = 0;
+    for (size_t k = eytzingerFirst(n); k != 0; k = eytzingerNext(k, n))
+    {
+        if (index == nodeCount(bst, node))
+        {
+            node = nodeSuccessor(bst, node);
+            index = 0;
+        }
+        nodeElement(bst, node, index++, &keys[k], &values[k]);
+    }
+    bst->frozenKeys = keys;
+    bst->frozenValues = values;
+    return true;
+}
+
+void bstThaw(BST *bst)
+{
+    free(bst->frozenKeys);
+    free(bst->frozenValues);
+    bst->frozenKeys = NULL;
+    bst->frozenValues = NULL;
+}
+
+size_t frozenLowerBound(BST *bst, void *key)
+{
+    void **keys = bst->frozenKeys;
+    size_t n = bst->size;
+    size_t k = 1;
+    while (k <= n)
+    {
+        if (FROZEN_AHEAD * k <= n)
+            PREFETCH(&keys[FROZEN_AHEAD * k]);
+        k = 2 * k + (bst->compfn(keys[k], key) < 0);
+    }
+    return eytzingerLowerBound(k);
+}
+
+void bstFreeNodes(BST *bst, bool freeKey, bool freeValue)
+{
+    size_t depth = 0;
+    for (NodeIndex i = bst->root; i != NIL; i = preorderNext(bst, i, &depth))
+    {
+        BNode *n = &bst->nodes[i];
+        if (freeKey)
+            free(n->key);
+        if (freeValue)
+            free(n->value);
+        Bucket *dups = nodeDups(bst, i);
+        if (dups != NULL)
+        {
+            for (size_t j = 0; j < dups->size; j++)
+            {
+                if (freeKey)
+                    free(dups->entries[j].key);
+                if (freeValue)
+                    free(dups->entries[j].value);
+            }
+            free(dups);
+        }
+    }
+}
+
+size_t bstSize(BST *bst)
+{
+    return bst->size;
+}
+
+bool bstInsert(BST *bst, void *key, void *value)
+{
+    if (bst->size == MAX_ELEMENTS)
+    {
+        printf("bstInsert: too many elements\n");
+        return false;
+    }
+    bstThaw(bst);
+    // the node that may be created is reserved first, so that the array of
+    // the nodes does not move once the path is followed
+    if (!nodesReserve(bst, 1))
+        return false;
+    BNode *nodes = bst->nodes;
+    NodeIndex prev = NIL;
+    NodeIndex n = bst->root;
+    int cmp = 0;
+    while (n != NIL)
+    {
+        cmp = bst->compfn(key, nodes[n].key);
+        if (cmp == 0)
+            break;
+        prev = n;
+        n = (cmp < 0) ? nodes[n].left : nodes[n].right;
+    }
 
+    bool created = (n == NIL);
+    if (!created)
+    {
+        // the key is already present: the element joins its bucket
+        if (!bucketAppend(bst, n, key, value))
+            return false;
+        nodes[n].size++;
+    }
+    else
+    {
+        n = bnNew(bst, key, value);
+        nodes[n].parent = prev;
+        if (prev == NIL)
+            bst->root = n;
+        else if (cmp < 0)
+            nodes[prev].left = n;
+        else
+            nodes[prev].right = n;
+    }
 
-/* Function definitions */
+    // the new element belongs to every subtree on its path
+    for (NodeIndex p = nodes[n].parent; p != NIL; p = nodes[p].parent)
+        nodes[p].size++;
+    if (created)
+    {
+        bstInsertFixup(bst, n);
+        bst->nnodes++;
+    }
+    bst->size++;
+    return true;
+}
 
-/* ------------------------------------------------------------------------- *
- * Computes the depth of a node inside a BST.
- *
- * PARAMETERS
- * n          			A valid pointer to a node object
- * totalNodeDepth     	The depth of the parent of the node.
- 
- * RETURN
- * bstDepthRec          The depth of the node.
- *
- * ------------------------------------------------------------------------- */
-int bstDepthRec(BNode *n, size_t totalNodeDepth);
+Bucket *nodeDups(BST *bst, NodeIndex n)
+{
+    return (bst->dups == NULL) ? NULL : bst->dups[n];
+}
 
-/* ------------------------------------------------------------------------- *
- * Performs an infix BST tree walk and inserts the searched values (in order)
- * in the provided list.
- *
- * PARAMETERS
- * bst          A valid pointer to a BST object.
- * n          	A valid pointer to a node object.
- * l	    	A valid pointer to a list object.
- * keymin		A valid pointer to the minimum value of the search range.
- * keymax		A valid pointer to the maximum value of the search range.
- *
- * ------------------------------------------------------------------------- */
-void inOrderTreeWalk(BST* bst, BNode* n, List* l, void *keymin, void *keymax);
+size_t nodeCount(BST *bst, NodeIndex n)
+{
+    Bucket *dups = nodeDups(bst, n);
+    return (dups == NULL) ? 1 : 1 + dups->size;
+}
 
-BNode *bnNew(void *key, void *value)
+bool bucketAppend(BST *bst, NodeIndex n, void *key, void *value)
 {
-    BNode *n = malloc(sizeof(BNode));
-    if (n == NULL)
+    if (bst->dups == NULL)
     {
-        printf("bnNew: allocation error\n");
-        return NULL;
+        bst->dups = calloc(bst->capacity, sizeof(Bucket *));
+        if (bst->dups == NULL)
+        {
+            printf("bucketAppend: allocation error\n");
+            return false;
+        }
     }
-    n->left = NULL;
-    n->right = NULL;
-    n->key = key;
-    n->value = value;
-    return n;
+    Bucket *dups = bst->dups[n];
+    if (dups == NULL || dups->size == dups->capacity)
+    {
+        size_t capacity = (dups == NULL) ? 3 : 2 * dups->capacity + 1;
+        Bucket *b = realloc(dups, sizeof(Bucket) + capacity * sizeof(Entry));
+        if (b == NULL)
+        {
+            printf("bucketAppend: allocation error\n");
+            return false;
+        }
+        if (dups == NULL)
+            b->size = 0;
+        b->capacity = capacity;
+        bst->dups[n] = dups = b;
+    }
+    dups->entries[dups->size].key = key;
+    dups->entries[dups->size].value = value;
+    dups->size++;
+    return true;
 }
 
-BST *bstNew(int comparison_fn_t(void *, void *))
+void nodeElement(BST *bst, NodeIndex n, size_t i, void **key, void **value)
 {
-    BST *bst = malloc(sizeof(BST));
-    if (bst == NULL)
-    {
-        printf("bestNew: allocation error");
-        return NULL;
-    }
-    bst->root = NULL;
-    bst->size = 0;
-    bst->compfn = comparison_fn_t;
-    return bst;
+    Bucket *dups = nodeDups(bst, n);
+    if (key != NULL)
+        *key = (i == 0) ? bst->nodes[n].key : dups->entries[i - 1].key;
+    if (value != NULL)
+        *value = (i == 0) ? bst->nodes[n].value : dups->entries[i - 1].value;
 }
 
-void bstFree(BST *bst, bool freeKey, bool freeValue)
+size_t nodeSize(BST *bst, NodeIndex n)
 {
-    bstFreeRec(bst->root, freeKey, freeValue);
-    free(bst);
+    // the NIL node has a size of 0
+    return bst->nodes[n].size;
 }
 
-void bstFreeRec(BNode *n, bool freeKey, bool freeValue)
+void leftRotate(BST *bst, NodeIndex x)
 {
-    if (n == NULL)
-        return;
-    bstFreeRec(n->left, freeKey, freeValue);
-    bstFreeRec(n->right, freeKey, freeValue);
-    if (freeKey)
-        free(n->key);
-    if (freeValue)
-        free(n->value);
-    free(n);
+    BNode *nodes = bst->nodes;
+    BNode *xn = &nodes[x];
+    NodeIndex y = xn->right;
+    BNode *yn = &nodes[y];
+    xn->right = yn->left;
+    if (yn->left != NIL)
+        nodes[yn->left].parent = x;
+    yn->parent = xn->parent;
+    if (xn->parent == NIL)
+        bst->root = y;
+    else if (x == nodes[xn->parent].left)
+        nodes[xn->parent].left = y;
+    else
+        nodes[xn->parent].right = y;
+    yn->left = x;
+    xn->parent = y;
+    yn->size = xn->size;
+    xn->size = nodeCount(bst, x) + nodeSize(bst, xn->left) + nodeSize(bst, xn->right);
 }
 
-size_t bstSize(BST *bst)
+void rightRotate(BST *bst, NodeIndex x)
 {
-    return bst->size;
+    BNode *nodes = bst->nodes;
+    BNode *xn = &nodes[x];
+    NodeIndex y = xn->left;
+    BNode *yn = &nodes[y];
+    xn->left = yn->right;
+    if (yn->right != NIL)
+        nodes[yn->right].parent = x;
+    yn->parent = xn->parent;
+    if (xn->parent == NIL)
+        bst->root = y;
+    else if (x == nodes[xn->parent].right)
+        nodes[xn->parent].right = y;
+    else
+        nodes[xn->parent].left = y;
+    yn->right = x;
+    xn->parent = y;
+    yn->size = xn->size;
+    xn->size = nodeCount(bst, x) + nodeSize(bst, xn->left) + nodeSize(bst, xn->right);
 }
 
-bool bstInsert(BST *bst, void *key, void *value)
+void bstInsertFixup(BST *bst, NodeIndex z)
 {
-    if (bst->root == NULL)
+    BNode *nodes = bst->nodes;
+    // z is red: only a red parent can break the red-black properties
+    while (nodes[z].parent != NIL && nodes[nodes[z].parent].color == RED)
     {
-        bst->root = bnNew(key, value);
-        if (bst->root == NULL)
+        // the parent is red, so it is not the root and the grandparent exists
+        NodeIndex p = nodes[z].parent;
+        NodeIndex gp = nodes[p].parent;
+        if (p == nodes[gp].left)
         {
-            return false;
+            NodeIndex uncle = nodes[gp].right;
+            if (uncle != NIL && nodes[uncle].color == RED)
+            {
+                // case 1 : recolor and move the violation up
+                nodes[p].color = BLACK;
+                nodes[uncle].color = BLACK;
+                nodes[gp].color = RED;
+                z = gp;
+            }
+            else
+            {
+                // case 2 : z is a right child, turn it into case 3
+                if (z == nodes[p].right)
+                {
+                    z = p;
+                    leftRotate(bst, z);
+                }
+                // case 3
+                nodes[nodes[z].parent].color = BLACK;
+                nodes[gp].color = RED;
+                rightRotate(bst, gp);
+            }
+        }
+        else
+        {
+            NodeIndex uncle = nodes[gp].left;
+            if (uncle != NIL && nodes[uncle].color == RED)
+            {
+                nodes[p].color = BLACK;
+                nodes[uncle].color = BLACK;
+                nodes[gp].color = RED;
+                z = gp;
+            }
+            else
+            {
+                if (z == nodes[p].left)
+                {
+                    z = p;
+                    rightRotate(bst, z);
+                }
+                nodes[nodes[z].parent].color = BLACK;
+                nodes[gp].color = RED;
+                leftRotate(bst, gp);
+            }
         }
-        bst->size++;
-        return true;
     }
-    BNode *prev = NULL;
-    BNode *n = bst->root;
-    while (n != NULL)
+    nodes[bst->root].color = BLACK;
+}
+
+void transplant(BST *bst, NodeIndex u, NodeIndex v)
+{
+    BNode *nodes = bst->nodes;
+    NodeIndex p = nodes[u].parent;
+    if (p == NIL)
+        bst->root = v;
+    else if (u == nodes[p].left)
+        nodes[p].left = v;
+    else
+        nodes[p].right = v;
+    if (v != NIL)
+        nodes[v].parent = p;
+}
+
+bool bstRemove(BST *bst, void *key, void *value)
+{
+    BNode *nodes = bst->nodes;
+    NodeIndex z = bst->root;
+    while (z != NIL)
     {
-        prev = n;
-        int cmp = bst->compfn(key, n->key);
-        if (cmp <= 0)
+        int cmp = bst->compfn(key, nodes[z].key);
+        if (cmp == 0)
+            break;
+        z = (cmp < 0) ? nodes[z].left : nodes[z].right;
+    }
+    if (z == NIL)
+        return false;
+
+    // the element is one of those of the node with that key
+    BNode *zn = &nodes[z];
+    size_t i = 0;
+    size_t count = nodeCount(bst, z);
+    for (; i < count; i++)
+    {
+        void *v;
+        nodeElement(bst, z, i, NULL, &v);
+        if (v == value)
+            break;
+    }
+    if (i == count)
+        return false;
+    bstThaw(bst);
+
+    if (count > 1)
+    {
+        // the last element of the bucket takes the place of the removed one,
+        // the node stays in the tree
+        Bucket *dups = bst->dups[z];
+        Entry last = dups->entries[--dups->size];
+        if (i == 0)
         {
-            n = n->left;
+            zn->key = last.key;
+            zn->value = last.value;
         }
-        else if (cmp > 0)
+        else
+        {
+            dups->entries[i - 1] = last;
+        }
+        if (dups->size == 0)
         {
-            n = n->right;
+            free(dups);
+            bst->dups[z] = NULL;
         }
+        for (NodeIndex p = z; p != NIL; p = nodes[p].parent)
+            nodes[p].size--;
+        bst->size--;
+        return true;
     }
-    BNode *new = bnNew(key, value);
-    if (new == NULL)
+
+    // y is the node that is actually unlinked from its place: z itself, or
+    // its successor which then takes the place of z
+    NodeIndex y = z;
+    Color removedColor = zn->color;
+    NodeIndex x, xParent;
+    if (zn->left == NIL)
     {
-        return false;
+        x = zn->right;
+        xParent = zn->parent;
+        transplant(bst, z, zn->right);
     }
-    new->parent = prev;
-    if (bst->compfn(key, prev->key) <= 0)
+    else if (zn->right == NIL)
     {
-        prev->left = new;
+        x = zn->left;
+        xParent = zn->parent;
+        transplant(bst, z, zn->left);
     }
     else
     {
-        prev->right = new;
+        y = zn->right;
+        while (nodes[y].left != NIL)
+            y = nodes[y].left;
+        removedColor = nodes[y].color;
+        x = nodes[y].right;
+        if (nodes[y].parent == z)
+        {
+            xParent = y;
+        }
+        else
+        {
+            xParent = nodes[y].parent;
+            transplant(bst, y, nodes[y].right);
+            nodes[y].right = zn->right;
+            nodes[nodes[y].right].parent = y;
+        }
+        transplant(bst, z, y);
+        nodes[y].left = zn->left;
+        nodes[nodes[y].left].parent = y;
+        nodes[y].color = zn->color;
     }
-    bst->size++;
+
+    // the sizes must be exact before the rotations of the fixup
+    for (NodeIndex p = xParent; p != NIL; p = nodes[p].parent)
+        nodes[p].size = nodeCount(bst, p) + nodeSize(bst, nodes[p].left) +
+                        nodeSize(bst, nodes[p].right);
+    if (removedColor == BLACK)
+        bstRemoveFixup(bst, x, xParent);
+
+    bnRelease(bst, z);
+    bst->size--;
+    bst->nnodes--;
     return true;
 }
 
+void bstRemoveFixup(BST *bst, NodeIndex x, NodeIndex xParent)
+{
+    BNode *nodes = bst->nodes;
+    // x carries an extra black: push it up or resolve it with rotations
+    while (x != bst->root && (x == NIL || nodes[x].color == BLACK))
+    {
+        if (x == nodes[xParent].left)
+        {
+            // the sibling exists since x's side lacks one black node
+            NodeIndex w = nodes[xParent].right;
+            if (nodes[w].color == RED)
+            {
+                // case 1 : make the sibling black
+                nodes[w].color = BLACK;
+                nodes[xParent].color = RED;
+                leftRotate(bst, xParent);
+                w = nodes[xParent].right;
+            }
+            if ((nodes[w].left == NIL || nodes[nodes[w].left].color == BLACK) &&
+                (nodes[w].right == NIL || nodes[nodes[w].right].color == BLACK))
+            {
+                // case 2 : recolor and move the extra black up
+                nodes[w].color = RED;
+                x = xParent;
+                xParent = nodes[x].parent;
+            }
+            else
+            {
+                // case 3 : make the far child of the sibling red
+                if (nodes[w].right == NIL || nodes[nodes[w].right].color == BLACK)
+                {
+                    nodes[nodes[w].left].color = BLACK;
+                    nodes[w].color = RED;
+                    rightRotate(bst, w);
+                    w = nodes[xParent].right;
+                }
+                // case 4
+                nodes[w].color = nodes[xParent].color;
+                nodes[xParent].color = BLACK;
+                nodes[nodes[w].right].color = BLACK;
+                leftRotate(bst, xParent);
+                x = bst->root;
+            }
+        }
+        else
+        {
+            NodeIndex w = nodes[xParent].left;
+            if (nodes[w].color == RED)
+            {
+                nodes[w].color = BLACK;
+                nodes[xParent].color = RED;
+                rightRotate(bst, xParent);
+                w = nodes[xParent].left;
+            }
+            if ((nodes[w].right == NIL || nodes[nodes[w].right].color == BLACK) &&
+                (nodes[w].left == NIL || nodes[nodes[w].left].color == BLACK))
+            {
+                nodes[w].color = RED;
+                x = xParent;
+                xParent = nodes[x].parent;
+            }
+            else
+            {
+                if (nodes[w].left == NIL || nodes[nodes[w].left].color == BLACK)
+                {
+                    nodes[nodes[w].right].color = BLACK;
+                    nodes[w].color = RED;
+                    leftRotate(bst, w);
+                    w = nodes[xParent].left;
+                }
+                nodes[w].color = nodes[xParent].color;
+                nodes[xParent].color = BLACK;
+                nodes[nodes[w].left].color = BLACK;
+                rightRotate(bst, xParent);
+                x = bst->root;
+            }
+        }
+    }
+    if (x != NIL)
+        nodes[x].color = BLACK;
+}
+
 void *bstSearch(BST *bst, void *key)
 {
-    BNode *n = bst->root;
-    while (n != NULL)
+    if (bst->frozenKeys != NULL)
+    {
+        size_t k = frozenLowerBound(bst, key);
+        if (k != 0 && bst->compfn(bst->frozenKeys[k], key) == 0)
+            return bst->frozenValues[k];
+        return NULL;
+    }
+
+    BNode *nodes = bst->nodes;
+    NodeIndex n = bst->root;
+    while (n != NIL)
     {
-        int cmp = bst->compfn(key, n->key);
+        int cmp = bst->compfn(key, nodes[n].key);
         if (cmp < 0)
         {
-            n = n->left;
+            n = nodes[n].left;
         }
         else if (cmp > 0)
         {
-            n = n->right;
+            n = nodes[n].right;
         }
         else
         {
-            return n->value;
+            return nodes[n].value;
         }
     }
     return NULL;
 }
 
-int bstDepthRec(BNode *n, size_t totalNodeDepth)
+bool bstSearchBatch(BST *bst, void **keys, size_t n, void **values)
 {
-    if (n == NULL)
+    Entry *queries = malloc(n * sizeof(Entry));
+    Entry *tmp = malloc(n * sizeof(Entry));
+    if (n > 0 && (queries == NULL || tmp == NULL))
     {
-        return 0;
+        printf("bstSearchBatch: allocation error\n");
+        free(queries);
+        free(tmp);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        values[i] = NULL;
+        queries[i].key = keys[i];
+        queries[i].value = &values[i];
+    }
+    entriesSort(bst->compfn, queries, tmp, n);
+    free(tmp);
+    searchBatchRec(bst, bst->root, queries, n);
+    free(queries);
+    return true;
+}
+
+void searchBatchRec(BST *bst, NodeIndex n, Entry *queries, size_t m)
+{
+    // the queries that are not found keep their NULL result
+    while (n != NIL && m > 0)
+    {
+        BNode *node = &bst->nodes[n];
+        // [lo, hi[ is the range of the queries equal to the key of n
+        size_t lo = 0, hi = m;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (bst->compfn(queries[mid].key, node->key) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        hi = lo;
+        while (hi < m && bst->compfn(queries[hi].key, node->key) == 0)
+        {
+            *(void **)queries[hi].value = node->value;
+            hi++;
+        }
+
+        // the smaller keys go left, and the loop follows the greater ones
+        searchBatchRec(bst, node->left, queries, lo);
+        queries += hi;
+        m -= hi;
+        n = node->right;
+    }
+}
+
+void bstSearchInterleaved(BST *bst, void **keys, size_t n, void **values)
+{
+    BNode *nodes[SEARCH_LANES]; // node to compare to in each lane
+    size_t queries[SEARCH_LANES]; // index of the query of each lane
+    size_t nlanes = 0, next = 0;
+
+    for (size_t i = 0; i < n; i++)
+        values[i] = NULL;
+    if (bst->root == NIL)
+        return;
+    BNode *root = &bst->nodes[bst->root];
+    for (; nlanes < SEARCH_LANES && next < n; nlanes++)
+    {
+        queries[nlanes] = next++;
+        nodes[nlanes] = root;
+    }
+
+    while (nlanes > 0)
+    {
+        // the nodes were prefetched at the previous step: their keys are
+        // requested all together before the first comparison needs one
+        for (size_t i = 0; i < nlanes; i++)
+            PREFETCH(nodes[i]->key);
+
+        size_t i = 0;
+        while (i < nlanes)
+        {
+            BNode *node = nodes[i];
+            NodeIndex child = NIL;
+            int cmp = bst->compfn(keys[queries[i]], node->key);
+            if (cmp == 0)
+                values[queries[i]] = node->value;
+            else
+                child = (cmp < 0) ? node->left : node->right;
+
+            if (child == NIL)
+            {
+                // the search of the lane is over: it starts the next query,
+                // or the last lane (not yet advanced) takes its place
+                if (next == n)
+                {
+                    nlanes--;
+                    queries[i] = queries[nlanes];
+                    nodes[i] = nodes[nlanes];
+                    continue;
+                }
+                queries[i] = next++;
+                child = bst->root;
+            }
+            nodes[i] = &bst->nodes[child];
+            PREFETCH(nodes[i]);
+            i++;
+        }
+    }
+}
+
+NodeIndex preorderNext(BST *bst, NodeIndex n, size_t *depth)
+{
+    BNode *nodes = bst->nodes;
+    if (nodes[n].left != NIL || nodes[n].right != NIL)
+    {
+        (*depth)++;
+        return (nodes[n].left != NIL) ? nodes[n].left : nodes[n].right;
     }
-    return bstDepthRec(n->right, totalNodeDepth + 1) + bstDepthRec(n->left, totalNodeDepth + 1) + totalNodeDepth;
+    // climbing up to the first ancestor whose right subtree is not walked
+    while (nodes[n].parent != NIL)
+    {
+        NodeIndex p = nodes[n].parent;
+        if (n == nodes[p].left && nodes[p].right != NIL)
+            return nodes[p].right;
+        n = p;
+        (*depth)--;
+    }
+    return NIL;
 }
 
 double bstAverageNodeDepth(BST *bst)
 {
-	double nodesNumber = (double) bst->size;
+	double nodesNumber = (double) bst->nnodes;
 	
-	if (nodesNumber == 0 || nodesNumber == 1 || bst->root == NULL)
+	if (nodesNumber == 0 || nodesNumber == 1 || bst->root == NIL)
 		return nodesNumber;
 	
-    BNode *n = bst->root;
-    int totalNodeDepth = bstDepthRec(n, 0);
+	size_t totalNodeDepth = 0;
+	size_t depth = 0;
+	for (NodeIndex n = bst->root; n != NIL; n = preorderNext(bst, n, &depth))
+		totalNodeDepth += depth;
 	return (totalNodeDepth/nodesNumber);
 }
 
-void inOrderTreeWalk(BST* bst, BNode* n, List* l,  void *keymin, void *keymax)
+void cursorInit(BSTCursor *c, BST *bst, void *keymin, void *keymax)
 {
-    if(n == NULL)
+    c->bst = bst;
+    c->node = NIL;
+    c->index = 0;
+    c->slot = 0;
+    c->keyMax = keymax;
+
+	//If keymin > keymax or binarySearchTree is empty, there is nothing to visit
+	if (bst->root == NIL || bst->compfn(keymin, keymax) > 0)
+		return;
+
+    if (bst->frozenKeys != NULL)
+    {
+        c->slot = frozenLowerBound(bst, keymin);
         return;
+    }
 
-    void *key = n->key;
-	int comp_keymin_key = bst->compfn(keymin, key);
-	int comp_keymax_key = bst->compfn(keymax, key);
-	
-	//Tree path left (recursive call)
-	if (comp_keymin_key <= 0)
-         inOrderTreeWalk(bst, n->left, l, keymin, keymax);
- 		
-	// Insert the value corresponding to the key only if keymin <= key <= keymax
-	if (comp_keymin_key <= 0 && comp_keymax_key >= 0)
-        listInsertLast(l, n->value);
+    // the first node whose key is >= keymin
+    NodeIndex n = bst->root;
+    while (n != NIL)
+    {
+        if (bst->compfn(bst->nodes[n].key, keymin) >= 0)
+        {
+            c->node = n;
+            n = bst->nodes[n].left;
+        }
+        else
+        {
+            n = bst->nodes[n].right;
+        }
+    }
+}
+
+BSTCursor *bstRangeCursorOpen(BST *bst, void *keyMin, void *keyMax)
+{
+    BSTCursor *c = malloc(sizeof(BSTCursor));
+    if (c == NULL)
+    {
+        printf("bstRangeCursorOpen: allocation error\n");
+        return NULL;
+    }
+    cursorInit(c, bst, keyMin, keyMax);
+    return c;
+}
+
+bool bstCursorNext(BSTCursor *c, void **key, void **value)
+{
+    BST *bst = c->bst;
+    if (bst->frozenKeys != NULL)
+    {
+        if (c->slot == 0 || bst->compfn(bst->frozenKeys[c->slot], c->keyMax) > 0)
+        {
+            c->slot = 0;
+            return false;
+        }
+        if (key != NULL)
+            *key = bst->frozenKeys[c->slot];
+        if (value != NULL)
+            *value = bst->frozenValues[c->slot];
+        c->slot = eytzingerNext(c->slot, bst->size);
+        return true;
+    }
+
+    if (c->node == NIL)
+        return false;
+    if (c->index == nodeCount(bst, c->node))
+    {
+        c->node = nodeSuccessor(bst, c->node);
+        c->index = 0;
+    }
+    // the keys are checked once per node, the duplicates of a key being
+    // all in the bucket of its node
+    if (c->index == 0 && (c->node == NIL || bst->compfn(bst->nodes[c->node].key, c->keyMax) > 0))
+    {
+        c->node = NIL;
+        return false;
+    }
+    nodeElement(bst, c->node, c->index++, key, value);
+    return true;
+}
+
+void bstCursorClose(BSTCursor *c)
+{
+    free(c);
+}
+
+bool bstRangeVisit(BST *bst, void *keymin, void *keymax,
+                   bool visit(void *key, void *value, void *ctx), void *ctx)
+{
+    BSTCursor c;
+    cursorInit(&c, bst, keymin, keymax);
+    void *key, *value;
+    while (bstCursorNext(&c, &key, &value))
+    {
+        if (!visit(key, value, ctx))
+            return false;
+    }
+    return true;
+}
 
-	// Tree path right (recursive call)
-	if (comp_keymax_key > 0)
-        inOrderTreeWalk(bst, n->right, l, keymin, keymax);
+bool collect(void *key, void *value, void *l)
+{
+    (void)key;
+    return listInsertLast(l, value);
 }
 
 List *bstRangeSearch(BST *bst, void *keymin, void *keymax)
@@ -235,25 +1474,130 @@ List *bstRangeSearch(BST *bst, void *keymin, void *keymax)
 	{
         return NULL;
 	}
-	
-	BNode* root = bst->root;
-	int comp_keymin_keymax = bst->compfn(keymin, keymax);
+	if (!bstRangeVisit(bst, keymin, keymax, collect, l))
+	{
+        listFree(l, false);
+        return NULL;
+	}
+	return l;
+}
 
-	//case 1 : If keymin > keymax or binarySearchTree is empty, return an empty list
-	if (comp_keymin_keymax > 0 || root == NULL)
-		return l;
-	
-	//case 2 : If keymin = keymax, search for the exact node inside the binarySearchTree
-	if (comp_keymin_keymax == 0)
+size_t countBelow(BST *bst, void *key, bool orEqual)
+{
+    size_t count = 0;
+    NodeIndex i = bst->root;
+    while (i != NIL)
     {
-		BNode* n = bstSearch(bst, keymin);
-		if(n != NULL)
-			listInsertFirst(l, n->value);
-		return l;
-	}
-	
-	//case 3 
-	inOrderTreeWalk(bst, root, l, keymin, keymax);
+        BNode *n = &bst->nodes[i];
+        int cmp = bst->compfn(n->key, key);
+        if (cmp < 0 || (orEqual && cmp == 0))
+        {
+            // n and its whole left subtree are below key
+            count += nodeSize(bst, n->left) + nodeCount(bst, i);
+            i = n->right;
+        }
+        else
+        {
+            i = n->left;
+        }
+    }
+    return count;
+}
 
-	return l;
-}
\ No newline at end of file
+size_t bstRangeCount(BST *bst, void *keymin, void *keymax)
+{
+    if (bst->root == NIL || bst->compfn(keymin, keymax) > 0)
+        return 0;
+    return countBelow(bst, keymax, true) - countBelow(bst, keymin, false);
+}
+
+size_t bstRank(BST *bst, void *key)
+{
+    return countBelow(bst, key, false);
+}
+
+NodeIndex nodeSelect(BST *bst, NodeIndex n, size_t *i)
+{
+    while (n != NIL)
+    {
+        BNode *node = &bst->nodes[n];
+        size_t left = nodeSize(bst, node->left);
+        if (*i < left)
+        {
+            n = node->left;
+        }
+        else if (*i < left + nodeCount(bst, n))
+        {
+            *i -= left;
+            return n;
+        }
+        else
+        {
+            *i -= left + nodeCount(bst, n);
+            n = node->right;
+        }
+    }
+    return NIL;
+}
+
+NodeIndex nodeSuccessor(BST *bst, NodeIndex n)
+{
+    BNode *nodes = bst->nodes;
+    if (nodes[n].right != NIL)
+    {
+        n = nodes[n].right;
+        while (nodes[n].left != NIL)
+            n = nodes[n].left;
+        return n;
+    }
+    while (nodes[n].parent != NIL && n == nodes[nodes[n].parent].right)
+        n = nodes[n].parent;
+    return nodes[n].parent;
+}
+
+bool bstSelect(BST *bst, size_t i, void **key, void **value)
+{
+    NodeIndex n = nodeSelect(bst, bst->root, &i);
+    if (n == NIL)
+        return false;
+    nodeElement(bst, n, i, key, value);
+    return true;
+}
+
+List *bstRangeSearchPage(BST *bst, void *keymin, void *keymax, size_t offset,
+                         size_t count)
+{
+    List *l = listNew();
+    if (l == NULL)
+        return NULL;
+    if (bst->root == NIL || bst->compfn(keymin, keymax) > 0)
+        return l;
+
+    // ranks [first, end) of the requested part of the range
+    size_t first = countBelow(bst, keymin, false);
+    size_t end = countBelow(bst, keymax, true);
+    if (offset >= end - first)
+        return l;
+    first += offset;
+    if (count < end - first)
+        end = first + count;
+
+    size_t j = first;
+    NodeIndex n = nodeSelect(bst, bst->root, &j);
+    for (size_t i = first; i < end; i++)
+    {
+        void *value;
+        nodeElement(bst, n, j, NULL, &value);
+        if (!listInsertLast(l, value))
+        {
+            listFree(l, false);
+            return NULL;
+        }
+        if (++j == nodeCount(bst, n))
+        {
+            n = nodeSuccessor(bst, n);
+            j = 0;
+        }
+    }
+    return l;
+}
@@ -11,6 +11,7 @@
 
 /* Opaque Structure */
 typedef struct BST_t BST;
+typedef struct BSTCursor_t BSTCursor;
 
 /* ------------------------------------------------------------------------- *
  * Creates an empty BST (or BST).
@@ -42,6 +43,28 @@ typedef struct BST_t BST;
 
 BST *bstNew(int comparison_fn_t(void *, void *));
 
+/* ------------------------------------------------------------------------- *
+ * Creates a BST holding the n given key-value pairs (keys[i] is associated
+ * to values[i]). The keys are sorted once and the tree is then built in
+ * linear time with a minimum height, whatever the order of the input.
+ *
+ * The BST must later be deleted by calling freeBST(). The arrays are not
+ * modified and may be freed once the function returns.
+ *
+ * ARGUMENT
+ * comparison_fn_t      A comparison function (see bstNew())
+ * keys                 An array of n keys
+ * values               An array of n values
+ * n                    The number of key-value pairs
+ *
+ * RETURN
+ * bst                  A pointer to the BST, or NULL in case of
+ *                      error
+ * ------------------------------------------------------------------------- */
+
+BST *bstBuildFromArrays(int comparison_fn_t(void *, void *), void **keys,
+                        void **values, size_t n);
+
 /* ------------------------------------------------------------------------- *
  * Frees the allocated memory of the given BST.
  *
@@ -54,6 +77,23 @@ BST *bstNew(int comparison_fn_t(void *, void *));
 
 void bstFree(BST *bst, bool freeKey, bool freeValue);
 
+/* ------------------------------------------------------------------------- *
+ * Freezes a BST: a copy of its keys and values is laid out in an array in
+ * Eytzinger (breadth-first) order, over which bstSearch and the range
+ * searches then descend without child pointers and with prefetching. This
+ * takes two pointers per element, and is meant for BSTs that are no longer
+ * modified: the next insertion or removal drops the frozen copy.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error (the BST
+ *              is then left unfrozen), true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bstFreeze(BST *bst);
+
 /* ------------------------------------------------------------------------- *
  * Counts the number of elements/nodes stored in the given BST.
  *
@@ -68,7 +108,10 @@ size_t bstSize(BST *bst);
 
 /* ------------------------------------------------------------------------- *
  * Inserts a new key-value pair in the provided BST. This
- * implementation of the BST allows duplicate keys.
+ * implementation of the BST allows duplicate keys: the elements with equal
+ * keys share a single node, so that duplicates do not make the tree any
+ * deeper. The tree is kept balanced (red-black tree), so that its height
+ * stays in O(log n) whatever the insertion order.
  *
  * PARAMETERS
  * bst          A valid pointer to a BST object
@@ -82,6 +125,24 @@ size_t bstSize(BST *bst);
 
 bool bstInsert(BST *bst, void *key, void *value);
 
+/* ------------------------------------------------------------------------- *
+ * Removes an element from the provided BST. Since keys may be duplicated,
+ * the element is identified by its key and its value (compared as
+ * pointers). The tree stays balanced. Neither the key nor the value is
+ * freed.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * key          The key of the element
+ * value        The value of the element
+ *
+ * RETURN
+ * res          A boolean equal to true if the element was found and
+ *              removed, false otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bstRemove(BST *bst, void *key, void *value);
+
 /* ------------------------------------------------------------------------- *
  * Returns the value associated to that key, if it belongs to the bst.
  * If duplicate copies of that key belongs to the bst, any one of the values
@@ -99,6 +160,43 @@ bool bstInsert(BST *bst, void *key, void *value);
 
 void *bstSearch(BST *bst, void *key);
 
+/* ------------------------------------------------------------------------- *
+ * Looks for a batch of keys at once, as n calls to bstSearch would. The keys
+ * are sorted first, then resolved by a single descent of the tree in which
+ * the queries sharing a path are carried together: each node is read once
+ * per batch instead of once per query.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * keys         An array of n keys to look for
+ * n            The number of keys
+ * values       An array of n pointers, the i-th one being set to one of the
+ *              values associated to keys[i], or NULL if it is not present
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error (values
+ *              is then left unchanged), true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bstSearchBatch(BST *bst, void **keys, size_t n, void **values);
+
+/* ------------------------------------------------------------------------- *
+ * Looks for a batch of keys, as n calls to bstSearch would. A group of
+ * searches is advanced in lockstep, each step prefetching the next node of
+ * every search, so that the cache misses of the group overlap instead of
+ * following each other. Unlike bstSearchBatch, nothing is sorted nor
+ * allocated: this pays off once the tree no longer fits in the cache.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * keys         An array of n keys to look for
+ * n            The number of keys
+ * values       An array of n pointers, the i-th one being set to one of the
+ *              values associated to keys[i], or NULL if it is not present
+ * ------------------------------------------------------------------------- */
+
+void bstSearchInterleaved(BST *bst, void **keys, size_t n, void **values);
+
 /* ------------------------------------------------------------------------- *
  * Returns the average depth of the BST nodes. The depth of a node is the
  * number of edges that connect it to the root (the root's depth is thus 0).
@@ -133,4 +231,142 @@ double bstAverageNodeDepth(BST *bst);
 
 List *bstRangeSearch(BST *bst, void *keyMin, void *keyMax);
 
+/* ------------------------------------------------------------------------- *
+ * Passes every element of the provided BST whose key is included in a range
+ * [keyMin, keyMax] to a callback, in the increasing order of the keys. No
+ * list is built: the walk stops as soon as the callback returns false.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * keyMin       Lower bound of the range (inclusive)
+ * keyMax       Upper bound of the range (inclusive)
+ * visit        The callback, called as visit(key, value, ctx). It returns
+ *              true to continue the walk, false to stop it
+ * ctx          A pointer passed unchanged to the callback
+ *
+ * RETURN
+ * res          A boolean equal to false if the callback stopped the walk,
+ *              true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bstRangeVisit(BST *bst, void *keyMin, void *keyMax,
+                   bool visit(void *key, void *value, void *ctx), void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the elements of the provided BST whose keys are included in a
+ * range [keyMin, keyMax]. The count relies on the sizes of the subtrees
+ * stored in the nodes: it takes O(log n) time and allocates nothing.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * keyMin       Lower bound of the range (inclusive)
+ * keyMax       Upper bound of the range (inclusive)
+ *
+ * RETURN
+ * nb           The number of elements in the range
+ * ------------------------------------------------------------------------- */
+
+size_t bstRangeCount(BST *bst, void *keyMin, void *keyMax);
+
+/* ------------------------------------------------------------------------- *
+ * Opens a cursor on the elements of the provided BST whose keys are
+ * included in a range [keyMin, keyMax]. The elements are then pulled one
+ * by one, in the increasing order of the keys, with bstCursorNext(): the
+ * caller may stop at any time without the rest of the range being walked.
+ *
+ * The cursor must later be deleted by calling bstCursorClose(). The BST
+ * must not be modified while the cursor is in use.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * keyMin       Lower bound of the range (inclusive)
+ * keyMax       Upper bound of the range (inclusive)
+ *
+ * RETURN
+ * c            A pointer to the cursor, or NULL in case of allocation error
+ * ------------------------------------------------------------------------- */
+
+BSTCursor *bstRangeCursorOpen(BST *bst, void *keyMin, void *keyMax);
+
+/* ------------------------------------------------------------------------- *
+ * Moves a cursor to the next element of its range. Each step takes O(1)
+ * amortized time.
+ *
+ * PARAMETERS
+ * c            A valid pointer to a BSTCursor object
+ * key          If not NULL, set to the key of the element
+ * value        If not NULL, set to the value of the element
+ *
+ * RETURN
+ * res          A boolean equal to false if the range is exhausted (key and
+ *              value are then left unchanged), true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bstCursorNext(BSTCursor *c, void **key, void **value);
+
+/* ------------------------------------------------------------------------- *
+ * Frees the allocated memory of the given cursor.
+ *
+ * PARAMETERS
+ * c            A valid pointer to a BSTCursor object
+ * ------------------------------------------------------------------------- */
+
+void bstCursorClose(BSTCursor *c);
+
+/* ------------------------------------------------------------------------- *
+ * Computes the rank of a key in the provided BST, that is the number of
+ * elements whose keys are strictly smaller. O(log n).
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * key          The key (it does not have to be in the BST)
+ *
+ * RETURN
+ * rank         The number of elements with a key smaller than key
+ * ------------------------------------------------------------------------- */
+
+size_t bstRank(BST *bst, void *key);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the element of rank i of the provided BST, that is the (i+1)-th
+ * element in the increasing order of the keys. O(log n).
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * i            The rank of the element (starting at 0)
+ * key          If not NULL, set to the key of the element
+ * value        If not NULL, set to the value of the element
+ *
+ * RETURN
+ * res          A boolean equal to false if i >= bstSize(bst), true
+ *              otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bstSelect(BST *bst, size_t i, void **key, void **value);
+
+/* ------------------------------------------------------------------------- *
+ * Returns one page of the result of bstRangeSearch(): the values of the
+ * elements of ranks offset to offset + count - 1 among the elements whose
+ * keys are included in [keyMin, keyMax], sorted in the increasing order of
+ * the keys. The elements before the page are skipped in O(log n) instead
+ * of being walked.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST object
+ * keyMin       Lower bound of the range (inclusive)
+ * keyMax       Upper bound of the range (inclusive)
+ * offset       The number of elements of the range to skip
+ * count        The maximum number of values to return
+ *
+ * RETURN
+ * l            A List containing at most count values, or NULL in case of
+ *              allocation error.
+ *
+ * NOTES
+ * The List must be freed but not its content.
+ * ------------------------------------------------------------------------- */
+
+List *bstRangeSearchPage(BST *bst, void *keyMin, void *keyMax, size_t offset,
+                         size_t count);
+
 #endif // !_BST_H_
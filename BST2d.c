@@ -5,152 +5,652 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
 
 #include "BST2d.h"
 #include "Point.h"
 #include "List.h"
+#include "Heap.h"
+
+// number of searches advanced together by bst2dSearchInterleaved
+#define SEARCH_LANES 16
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+// index standing for no node: the slot 0 of the array of the nodes is
+// never used
+#define NIL 0
+
+// number of slots of the array of the nodes that 32-bit indices can address
+#define MAX_NODES ((size_t)UINT32_MAX)
+
+// number of elements that the 32-bit subtree sizes can count
+#define MAX_ELEMENTS ((size_t)UINT32_MAX)
 
 /* Opaque Structure */
 
 typedef struct BNode_t BNode;
 
+// the nodes are addressed by their index in the array of their tree, which
+// takes half the size of a pointer
+typedef uint32_t NodeIndex;
+
+typedef struct Dup_t Dup;
+
+struct Dup_t
+{
+    Point point;
+    void *value;
+};
+
+typedef struct Bucket_t Bucket;
+
+// the elements of a node beyond the first one, whose positions are all
+// identical to the position of the node
+struct Bucket_t
+{
+    size_t size;
+    size_t capacity;
+    Dup entries[];
+};
+
+// the nodes have no parent link: the updates of the sizes and of the boxes
+// are made along the path from the root. 56 bytes: the buckets of duplicate
+// positions are kept out of the nodes (see BST2d_t).
 struct BNode_t
 {
-    BNode *parent;
-    BNode *left;
-    BNode *right;
-    Point *point; 
+    Point point; // copy of the position, read without another cache miss
+    void *value;
+    // bounding box of the positions of the subtree rooted at this node,
+    // rounded outwards to floats: it may only be larger than the exact one,
+    // which the prunings and the whole subtree counts allow
+    float xmin;
+    float xmax;
+    float ymin;
+    float ymax;
+    NodeIndex left;
+    NodeIndex right;
+    uint32_t size; // number of elements in the subtree rooted at this node
+};
+
+typedef struct Entry_t Entry;
+
+struct Entry_t
+{
+    Point point;
     void *value;
 };
 
+typedef struct Step_t Step;
+
+// a node on the path of a removal
+struct Step_t
+{
+    NodeIndex node;
+    bool replaced; // whether the node takes the element of a descendant
+};
+
+typedef struct Path_t Path;
+
+// the nodes met by a removal from the root, in an array that grows as
+// needed: the height of the tree is not bounded
+struct Path_t
+{
+    Step *steps;
+    size_t length;
+    size_t capacity;
+};
+
 struct BST2d_t
 {
-    BNode *root;
+    NodeIndex root;
     size_t size;
+    size_t nnodes; // number of nodes, i.e. of distinct positions
+    // storage of the nodes. The array may be moved when it grows, so the
+    // nodes are linked by their indices.
+    BNode *nodes;
+    size_t capacity; // number of slots of nodes
+    size_t used; // number of slots taken so far, released ones included
+    NodeIndex released; // first released slot, the next ones being linked
+                        // through their right field (NIL if none)
+    // other elements at the same position as each node (NULL if none), as
+    // many slots as nodes. Few positions are duplicated: the array is only
+    // allocated with the first bucket (NULL until then).
+    Bucket **dups;
 };
 
 /* Function definitions */
 
 /* ------------------------------------------------------------------------- *
- * Frees the allocated memory of the given node.
+ * Frees the values and the buckets of the subtree rooted at the given node
+ * (the nodes belong to the array of the tree).
  *
  * PARAMETERS
- * n          	A valid pointer to a node object.
- * freeKey      Whether to free the keys.
+ * bst2d        A valid pointer to a BST2d object.
+ * n          	A node of bst2d (possibly NIL).
  * freeValue    Whether to free the values.
  *
  * ------------------------------------------------------------------------- */
-static void bstFreeRec(BNode *n, bool freeKey, bool freeValue);
+static void bstFreeRec(BST2d *bst2d, NodeIndex n, bool freeValue);
+
+/* ------------------------------------------------------------------------- *
+ * Grows the array of the nodes of a BST2d, if needed, so that n nodes can
+ * be created without moving it.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n            The number of nodes to make room for.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error, or if
+ *              the nodes would not be addressable with 32-bit indices.
+ * ------------------------------------------------------------------------- */
+static bool nodesReserve(BST2d *bst2d, size_t n);
 
 /* ------------------------------------------------------------------------- *
- * Creates a new node
+ * Gives the slot of a node back to its BST2d, for a later bnNew().
  *
- * The BNode must later be deleted by calling bstFreeRec().
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * i            The index of a node of bst2d that is not linked anymore.
+ *
+ * ------------------------------------------------------------------------- */
+static void bnRelease(BST2d *bst2d, NodeIndex i);
+
+/* ------------------------------------------------------------------------- *
+ * Creates a new node, in a released slot or in a slot reserved by
+ * nodesReserve() (the array of the nodes does not move).
+ *
+ * The BNode is released with the array of the BST2d.
  *
  * PARAMETERS
- * point		The position of the new element (a Point object).
+ * bst2d        A valid pointer to the BST2d the node is created for.
+ * point		The position of the new element (copied in the node).
  * value    	The value to store.
  *
  * RETURN
- * BNode        A pointer to the node, or NULL in case of error.
+ * i            The index of the node.
  * ------------------------------------------------------------------------- */
-static BNode *bnNew(Point *point, void *value);
+static NodeIndex bnNew(BST2d *bst2d, Point *point, void *value);
 
 /* ------------------------------------------------------------------------- *
- * Compares two points in order to place them correctly in the tree.
+ * Returns the coordinate of an entry on which a node at the given depth
+ * splits (x for even depths, y for odd depths).
  *
  * PARAMETERS
- * p1, p2		Two valid pointers to point objets.
- * depth    	The depth of the BST2d.
+ * e            A valid pointer to an entry.
+ * depth        The depth of the node.
  *
  * RETURN
- * nb			The result of the comparison.
+ * c            The coordinate of e.
  * ------------------------------------------------------------------------- */
-static int compare(Point *p1, Point *p2, size_t depth);
+static double entryCoord(Entry *e, size_t depth);
 
 /* ------------------------------------------------------------------------- *
- * Compares two points in order to define if they are identical or not.
+ * Rearranges the entries around the k-th smallest coordinate v (quickselect
+ * with a three-way partition, linear expected time). On return, the entries
+ * in [0, *lo) have a coordinate < v, those in [*lo, *hi) are equal to v and
+ * those in [*hi, n) are > v, with *lo <= k < *hi.
  *
  * PARAMETERS
- * p1, p2		Two valid pointers to point objets.
- * depth    	The depth of the BST2d.
+ * entries      The entries to rearrange.
+ * n            The number of entries.
+ * k            The rank of the coordinate to select.
+ * depth        The depth of the node (selects the x or y coordinate).
+ * lo, hi       Set to the bounds of the block of entries equal to v.
+ *
+ * ------------------------------------------------------------------------- */
+static void entriesSelect(Entry *entries, size_t n, size_t k, size_t depth,
+                          size_t *lo, size_t *hi);
+
+/* ------------------------------------------------------------------------- *
+ * Builds a balanced subtree from an array of entries, splitting on the
+ * median coordinate. Entries equal to the median on the split axis go to
+ * the left, as in bst2dInsert.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to the BST2d the nodes are created for
+ *              (with room for n nodes, see nodesReserve).
+ * entries      The entries of the subtree (rearranged by the function).
+ * n            The number of entries.
+ * depth        The depth of the root of the subtree.
+ * error        Set to true in case of allocation error.
  *
  * RETURN
- * res          A boolean equal to true if both the points are identical,
- *				false otherwisethe.
+ * n            The root of the subtree (NIL if n = 0).
  * ------------------------------------------------------------------------- */
-static bool Equal(Point *p1, Point *p2, size_t depth);
+static NodeIndex bst2dBuildRec(BST2d *bst2d, Entry *entries, size_t n,
+                               size_t depth, bool *error);
 
 /* ------------------------------------------------------------------------- *
- * Detects if a point is inside or oustide the search radius.
+ * Rounds a coordinate to the largest float that is not greater.
  *
  * PARAMETERS
- * n			A valid pointer to a node objet.
+ * v			The coordinate.
+ *
+ * RETURN
+ * f			The float, -INFINITY if v is below the range of the floats.
+ * ------------------------------------------------------------------------- */
+static float floatBelow(double v);
+
+/* ------------------------------------------------------------------------- *
+ * Rounds a coordinate to the smallest float that is not lower.
+ *
+ * PARAMETERS
+ * v			The coordinate.
+ *
+ * RETURN
+ * f			The float, INFINITY if v is above the range of the floats.
+ * ------------------------------------------------------------------------- */
+static float floatAbove(double v);
+
+/* ------------------------------------------------------------------------- *
+ * Sets the bounding box of a node to its own position.
+ *
+ * PARAMETERS
+ * n			A valid pointer to a node object.
+ *
+ * ------------------------------------------------------------------------- */
+static void boxReset(BNode *n);
+
+/* ------------------------------------------------------------------------- *
+ * Extends the bounding box of a node so that it contains a position.
+ *
+ * PARAMETERS
+ * n			A valid pointer to a node object.
+ * x, y			The coordinates of the position.
+ *
+ * ------------------------------------------------------------------------- */
+static void boxExtend(BNode *n, double x, double y);
+
+/* ------------------------------------------------------------------------- *
+ * Recomputes the size and the bounding box of a node from its own position
+ * and from its children.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d.
+ *
+ * ------------------------------------------------------------------------- */
+static void nodeUpdate(BST2d *bst2d, NodeIndex n);
+
+/* ------------------------------------------------------------------------- *
+ * Follows the path of a position from the root of a BST2d, down to the node
+ * at that position or to the place where it would be inserted. The nodes
+ * met before gain an element, their boxes being extended to the position,
+ * or lose one.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * x, y			The coordinates of the position.
+ * add			Whether an element is added to the nodes of the path, or
+ *				removed from them.
+ *
+ * RETURN
+ * link			The link (the root or a child field) holding the node at
+ *				the position, or NIL if there is none.
+ * ------------------------------------------------------------------------- */
+static NodeIndex *pathUpdate(BST2d *bst2d, double x, double y, bool add);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the node at a given position.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * x, y			The coordinates of the position.
+ *
+ * RETURN
+ * n			The node at the position, or NIL if there is none.
+ * ------------------------------------------------------------------------- */
+static NodeIndex nodeFind(BST2d *bst2d, double x, double y);
+
+/* ------------------------------------------------------------------------- *
+ * Appends a node to a path, growing its array if needed.
+ *
+ * PARAMETERS
+ * path			A valid pointer to a path.
+ * n			The node.
+ * replaced		Whether n takes the element of a descendant.
+ *
+ * RETURN
+ * res			A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool pathPush(Path *path, NodeIndex n, bool replaced);
+
+/* ------------------------------------------------------------------------- *
+ * Removes the node at a given position, its element being already removed.
+ * A node with children takes the element of its descendant with the
+ * largest coordinate on its axis, whose node is removed in turn, down to a
+ * leaf. The path from the root to that leaf is first recorded without
+ * changing the tree, then the elements are moved along it, the leaf is
+ * released and the nodes of the path are updated from the bottom up.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * x, y			The coordinates of the position (present in bst2d).
+ *
+ * RETURN
+ * res			A boolean equal to false in case of allocation error, the
+ *				tree being left unchanged.
+ * ------------------------------------------------------------------------- */
+static bool nodeRemove(BST2d *bst2d, double x, double y);
+
+/* ------------------------------------------------------------------------- *
+ * Returns the bucket of the elements of a node beyond its own one.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d.
+ *
+ * RETURN
+ * b			The bucket of n, or NULL if n holds a single element.
+ * ------------------------------------------------------------------------- */
+static Bucket *nodeDups(BST2d *bst2d, NodeIndex n);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the elements held by a node (its own and those of its bucket).
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d.
+ *
+ * RETURN
+ * nb			The number of elements of the node.
+ * ------------------------------------------------------------------------- */
+static size_t nodeCount(BST2d *bst2d, NodeIndex n);
+
+/* ------------------------------------------------------------------------- *
+ * Adds an element to the bucket of a node, at the position of the node.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d.
+ * point		The position of the element (identical to the one of n).
+ * value		The value of the element.
+ *
+ * RETURN
+ * res			A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool bucketAppend(BST2d *bst2d, NodeIndex n, Point *point, void *value);
+
+/* ------------------------------------------------------------------------- *
+ * Passes the values of all the elements of a node to a callback.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d.
+ * visit		The callback, called as visit(value, ctx).
+ * ctx			A pointer passed unchanged to the callback.
+ *
+ * RETURN
+ * res			A boolean equal to false if the callback asked to stop.
+ * ------------------------------------------------------------------------- */
+static bool nodeVisit(BST2d *bst2d, NodeIndex n, bool visit(void *, void *),
+                      void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the node of the subtree rooted at n holding the largest coordinate
+ * on a given axis. Subtrees splitting on this axis are only searched on
+ * their right, and subtrees whose bounding box cannot beat the best node
+ * so far are skipped.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d (possibly NIL).
+ * depth		The depth of n.
+ * axis			0 for x, 1 for y.
+ * best			The best node found so far (possibly NIL).
+ *
+ * RETURN
+ * best			The node with the largest coordinate.
+ * ------------------------------------------------------------------------- */
+static NodeIndex maxOnAxis(BST2d *bst2d, NodeIndex n, size_t depth,
+                           size_t axis, NodeIndex best);
+
+/* ------------------------------------------------------------------------- *
+ * Computes the square of the smallest distance between a point and the
+ * bounding box of the subtree rooted at a node (0 if the point is inside).
+ *
+ * PARAMETERS
+ * n			A valid pointer to a node object.
+ * q			A valid pointer to a point object.
+ *
+ * RETURN
+ * d			The square distance between q and the box of n.
+ * ------------------------------------------------------------------------- */
+static double boxSqrDistance(BNode *n, Point *q);
+
+/* ------------------------------------------------------------------------- *
+ * Computes the square of the largest distance between a point and the
+ * bounding box of the subtree rooted at a node.
+ *
+ * PARAMETERS
+ * n			A valid pointer to a node object.
+ * q			A valid pointer to a point object.
+ *
+ * RETURN
+ * d			The square distance between q and the farthest corner of the
+ *				box of n.
+ * ------------------------------------------------------------------------- */
+static double boxSqrMaxDistance(BNode *n, Point *q);
+
+/* ------------------------------------------------------------------------- *
+ * Resolves a group of exact searches in the subtree rooted at a given node.
+ * The queries at the position of the node are answered there, and the
+ * others are partitioned in place between both subtrees, so each node is
+ * read once per batch whatever the number of queries reaching it.
+ * searchBatchX handles the nodes splitting on x and searchBatchY those
+ * splitting on y, as ballVisitX and ballVisitY.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			The root of the subtree (may be NIL).
+ * points		The positions looked for.
+ * queries		The indices in points of the queries of the group.
+ * m			The number of queries of the group.
+ * values		The results, indexed like points.
+ *
+ * ------------------------------------------------------------------------- */
+static void searchBatchX(BST2d *bst2d, NodeIndex n, Point **points,
+                         size_t *queries, size_t m, void **values);
+static void searchBatchY(BST2d *bst2d, NodeIndex n, Point **points,
+                         size_t *queries, size_t m, void **values);
+
+/* ------------------------------------------------------------------------- *
+ * Detects if a point is inside or oustide the search radius, and passes the
+ * values of the points inside to the callback. Subtrees whose bounding box
+ * lies entirely outside the ball are skipped. ballVisitX handles the nodes
+ * splitting on x (even depths) and ballVisitY those splitting on y (odd
+ * depths), each one calling the other for the children.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d (possibly NIL).
  * q	    	A valid pointer to a point objet.
  * r			The radius of the ball.
- * depth		The depth of the node.
- * list			A valid pointer to a list objet.
- * error		A boolean value to detect if errors occur inside the function.
+ * visit		The callback.
+ * ctx			The context passed to the callback.
  *
+ * RETURN
+ * res          A boolean equal to false if the callback stopped the search,
+ *              true otherwise.
  * ------------------------------------------------------------------------- */
-static void bst2dBallSearchRec(BNode *n, Point *q, double r, size_t depth, List *list, bool *error);
+static bool ballVisitX(BST2d *bst2d, NodeIndex n, Point *q, double r, bool visit(void *, void *), void *ctx);
+static bool ballVisitY(BST2d *bst2d, NodeIndex n, Point *q, double r, bool visit(void *, void *), void *ctx);
 
 /* ------------------------------------------------------------------------- *
- * Defines if the search should continue on the left.
+ * Passes the values of all the nodes of a subtree to the callback, without
+ * any distance test.
  *
  * PARAMETERS
- * p1, p2		Two valid pointers to point objets.
- * r			The radius of the ball.
- * depth    	The depth of the BST2d.
- 
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d (possibly NIL).
+ * visit		The callback.
+ * ctx			The context passed to the callback.
+ *
  * RETURN
- * res          A boolean equal to true if the seach continues,
- *				false otherwisethe.
+ * res          A boolean equal to false if the callback stopped the walk,
+ *              true otherwise.
+ * ------------------------------------------------------------------------- */
+static bool bst2dVisitAllRec(BST2d *bst2d, NodeIndex n, bool visit(void *, void *), void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Inserts a value at the end of a list (callback of bst2dBallVisit used by
+ * bst2dBallSearch).
  *
+ * PARAMETERS
+ * value        The value to insert.
+ * l            A valid pointer to a list object.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error.
  * ------------------------------------------------------------------------- */
-bool continueLeft(Point *p1, Point *p2, double r, size_t depth);
+static bool collect(void *value, void *l);
 
 /* ------------------------------------------------------------------------- *
- * Defines if the search should continue on the right.
+ * Counts the points of the subtree rooted at n that are inside the ball.
+ * The whole size of the subtrees covered by the ball is added at once.
+ * ballCountX handles the nodes splitting on x and ballCountY those
+ * splitting on y, as ballVisitX and ballVisitY.
  *
  * PARAMETERS
- * p1, p2		Two valid pointers to point objets.
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d (possibly NIL).
+ * q	    	A valid pointer to a point objet.
  * r			The radius of the ball.
- * depth    	The depth of the BST2d.
- 
+ *
+ * RETURN
+ * nb			The number of points of the subtree inside the ball.
+ * ------------------------------------------------------------------------- */
+static size_t ballCountX(BST2d *bst2d, NodeIndex n, Point *q, double r);
+static size_t ballCountY(BST2d *bst2d, NodeIndex n, Point *q, double r);
+
+/* ------------------------------------------------------------------------- *
+ * Collects the k nearest neighbours of q in the subtree rooted at n. The
+ * child on the side of q is explored first, and the other one only if its
+ * bounding box is closer to q than the current k-th nearest neighbour.
+ * kNearestX handles the nodes splitting on x and kNearestY those splitting
+ * on y, as ballVisitX and ballVisitY.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d (possibly NIL).
+ * q	    	A valid pointer to a point objet.
+ * k			The number of neighbours to look for.
+ * heap			A max-heap holding the (at most k) best candidates so far,
+ *				with their square distances to q as priorities.
+ * error		A boolean value to detect if errors occur inside the function.
+ *
+ * ------------------------------------------------------------------------- */
+static void kNearestX(BST2d *bst2d, NodeIndex n, Point *q, size_t k, Heap *heap, bool *error);
+static void kNearestY(BST2d *bst2d, NodeIndex n, Point *q, size_t k, Heap *heap, bool *error);
+
+/* ------------------------------------------------------------------------- *
+ * Offers the values of a node to the heap of a k nearest neighbours search.
+ *
+ * PARAMETERS
+ * bst2d        A valid pointer to a BST2d object.
+ * n			A node of bst2d.
+ * q	    	A valid pointer to a point objet.
+ * k			The number of neighbours to look for.
+ * heap			The heap of the search.
+ *
  * RETURN
- * res          A boolean equal to true if the seach continues,
- *				false otherwisethe.
+ * res          A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool nodeOffer(BST2d *bst2d, NodeIndex n, Point *q, size_t k, Heap *heap);
+
+/* ------------------------------------------------------------------------- *
+ * Tells whether a node is at a given position.
+ *
+ * PARAMETERS
+ * n			A valid pointer to a node objet.
+ * x, y			The coordinates of the position.
  *
+ * RETURN
+ * res          A boolean equal to true if the node is at (x, y).
  * ------------------------------------------------------------------------- */
-bool continueRight(Point *p1, Point *p2, double r, size_t depth);
+static bool isAt(BNode *n, double x, double y);
 
 /* ------------------------------------------------------------------------- *
  * Computes the depth of a node inside a BST2d.
  *
  * PARAMETERS
- * n          			A valid pointer to a node object
+ * bst2d                A valid pointer to a BST2d object
+ * n          			A node of bst2d (possibly NIL)
  * totalNodeDepth     	The depth of the parent of the node.
  
  * RETURN
  * bstDepthRec          The depth of the node.
  *
  * ------------------------------------------------------------------------- */
-int bst2dDepthRec(BNode *n, int totalNodeDepth);
+int bst2dDepthRec(BST2d *bst2d, NodeIndex n, int totalNodeDepth);
 
-BNode *bnNew(Point *point, void *value)
+bool nodesReserve(BST2d *bst2d, size_t n)
 {
-    BNode *n = malloc(sizeof(BNode));
-    if (n == NULL)
+    if (n <= bst2d->capacity - bst2d->used)
+        return true;
+    if (n > MAX_NODES - bst2d->used)
     {
-        printf("bnNew: allocation error\n");
-        return NULL;
+        printf("nodesReserve: too many nodes\n");
+        return false;
     }
-    n->left = NULL;
-    n->right = NULL;
-    n->point = point;
+    // the array grows by half of its size, within the reach of the indices
+    size_t capacity = bst2d->capacity + bst2d->capacity / 2;
+    if (capacity < bst2d->used + n)
+        capacity = bst2d->used + n;
+    if (capacity > MAX_NODES)
+        capacity = MAX_NODES;
+    if (bst2d->dups != NULL)
+    {
+        Bucket **dups = realloc(bst2d->dups, capacity * sizeof(Bucket *));
+        if (dups == NULL)
+        {
+            printf("nodesReserve: allocation error\n");
+            return false;
+        }
+        for (size_t i = bst2d->capacity; i < capacity; i++)
+            dups[i] = NULL;
+        bst2d->dups = dups;
+    }
+    BNode *nodes = realloc(bst2d->nodes, capacity * sizeof(BNode));
+    if (nodes == NULL)
+    {
+        printf("nodesReserve: allocation error\n");
+        return false;
+    }
+    bst2d->nodes = nodes;
+    bst2d->capacity = capacity;
+    return true;
+}
+
+NodeIndex bnNew(BST2d *bst2d, Point *point, void *value)
+{
+    NodeIndex i = bst2d->released;
+    if (i != NIL)
+        bst2d->released = bst2d->nodes[i].right;
+    else
+        i = (NodeIndex)bst2d->used++;
+    BNode *n = &bst2d->nodes[i];
+    n->left = NIL;
+    n->right = NIL;
+    n->point = *point;
     n->value = value;
-    return n;
+    boxReset(n);
+    n->size = 1;
+    return i;
+}
+
+void bnRelease(BST2d *bst2d, NodeIndex i)
+{
+    bst2d->nodes[i].right = bst2d->released;
+    bst2d->released = i;
 }
 
 BST2d *bst2dNew(void)
@@ -161,28 +661,193 @@ BST2d *bst2dNew(void)
         printf("bst2dNew: allocation error");
         return NULL;
     }
-    bst2d->root = NULL;
-    bst2d->size = 0;
+    bst2d->nodes = malloc(sizeof(BNode)); // the unused slot 0
+    if (bst2d->nodes == NULL)
+    {
+        printf("bst2dNew: allocation error\n");
+        free(bst2d);
+        return NULL;
+    }
+    bst2d->capacity = 1;
+    bst2d->used = 1;
+    bst2d->released = NIL;
+    bst2d->dups = NULL;
+    bst2d->root = NIL;
+    bst2d->size = 0;
+    bst2d->nnodes = 0;
+    return bst2d;
+}
+
+double entryCoord(Entry *e, size_t depth)
+{
+    return (depth % 2 == 0) ? e->point.x : e->point.y;
+}
+
+void entriesSelect(Entry *entries, size_t n, size_t k, size_t depth,
+                   size_t *lo, size_t *hi)
+{
+    size_t first = 0, last = n;
+    while (true)
+    {
+        // median of three as pivot, so that sorted inputs stay linear
+        double a = entryCoord(&entries[first], depth);
+        double b = entryCoord(&entries[first + (last - first) / 2], depth);
+        double c = entryCoord(&entries[last - 1], depth);
+        double pivot = (a < b) ? ((b < c) ? b : ((a < c) ? c : a))
+                               : ((a < c) ? a : ((b < c) ? c : b));
+
+        // three-way partition of [first, last): < pivot | = pivot | > pivot
+        size_t lt = first, i = first, gt = last;
+        while (i < gt)
+        {
+            double ci = entryCoord(&entries[i], depth);
+            Entry tmp = entries[i];
+            if (ci < pivot)
+            {
+                entries[i++] = entries[lt];
+                entries[lt++] = tmp;
+            }
+            else if (ci > pivot)
+            {
+                entries[i] = entries[--gt];
+                entries[gt] = tmp;
+            }
+            else
+                i++;
+        }
+
+        if (k < lt)
+            last = lt;
+        else if (k >= gt)
+            first = gt;
+        else
+        {
+            *lo = lt;
+            *hi = gt;
+            return;
+        }
+    }
+}
+
+NodeIndex bst2dBuildRec(BST2d *bst2d, Entry *entries, size_t n, size_t depth,
+                        bool *error)
+{
+    if (n == 0 || *error)
+        return NIL;
+    size_t lo, hi;
+    entriesSelect(entries, n, n / 2, depth, &lo, &hi);
+
+    // the entries at the same position as the last entry equal to the median
+    // are moved to the end of [lo, hi) and form the root: all the other
+    // equal ones go to its left subtree, the greater ones to its right one
+    double x = entries[hi - 1].point.x, y = entries[hi - 1].point.y;
+    size_t mid = hi;
+    for (size_t i = hi; i-- > lo;)
+    {
+        if (entries[i].point.x == x && entries[i].point.y == y)
+        {
+            Entry tmp = entries[i];
+            entries[i] = entries[--mid];
+            entries[mid] = tmp;
+        }
+    }
+    NodeIndex index = bnNew(bst2d, &entries[mid].point, entries[mid].value);
+    BNode *node = &bst2d->nodes[index];
+    for (size_t i = mid + 1; i < hi; i++)
+    {
+        if (!bucketAppend(bst2d, index, &entries[i].point, entries[i].value))
+        {
+            *error = true;
+            return NIL;
+        }
+    }
+    bst2d->nnodes++;
+    node->size = (uint32_t)n;
+    node->left = bst2dBuildRec(bst2d, entries, mid, depth + 1, error);
+    node->right = bst2dBuildRec(bst2d, entries + hi, n - hi, depth + 1, error);
+    NodeIndex children[2] = {node->left, node->right};
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (children[i] == NIL)
+            continue;
+        BNode *child = &bst2d->nodes[children[i]];
+        boxExtend(node, child->xmin, child->ymin);
+        boxExtend(node, child->xmax, child->ymax);
+    }
+    return index;
+}
+
+BST2d *bst2dBuildFromArrays(Point **points, void **values, size_t n)
+{
+    if (n > MAX_ELEMENTS)
+    {
+        printf("bst2dBuildFromArrays: too many elements\n");
+        return NULL;
+    }
+    BST2d *bst2d = bst2dNew();
+    if (bst2d == NULL)
+        return NULL;
+    if (n == 0)
+        return bst2d;
+
+    // the array of the nodes is sized once, and filled in preorder
+    Entry *entries = malloc(n * sizeof(Entry));
+    if (entries == NULL || !nodesReserve(bst2d, n))
+    {
+        printf("bst2dBuildFromArrays: allocation error\n");
+        free(entries);
+        bst2dFree(bst2d, false, false);
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        entries[i].point = *points[i];
+        entries[i].value = values[i];
+    }
+
+    bool error = false;
+    bst2d->root = bst2dBuildRec(bst2d, entries, n, 0, &error);
+    free(entries);
+    bst2d->size = n;
+    if (error)
+    {
+        bst2dFree(bst2d, false, false);
+        return NULL;
+    }
     return bst2d;
 }
 
 void bst2dFree(BST2d *bst2d, bool freeKey, bool freeValue)
 {
-    bstFreeRec(bst2d->root, freeKey, freeValue);
+    // the keys are the coordinates copied into the nodes, which go with
+    // the array of the nodes: there is no key to free
+    (void)freeKey;
+    // the nodes themselves are released with their array, the tree only
+    // needs to be walked when values are owned, or to free the buckets of
+    // duplicate positions
+    if (freeValue || bst2d->size != bst2d->nnodes)
+        bstFreeRec(bst2d, bst2d->root, freeValue);
+    free(bst2d->dups);
+    free(bst2d->nodes);
     free(bst2d);
 }
 
-void bstFreeRec(BNode *n, bool freeKey, bool freeValue)
+void bstFreeRec(BST2d *bst2d, NodeIndex i, bool freeValue)
 {
-    if (n == NULL)
+    if (i == NIL)
         return;
-    bstFreeRec(n->left, freeKey, freeValue);
-    bstFreeRec(n->right, freeKey, freeValue);
-    if (freeKey)
-        ptFree(n->point);
+    BNode *n = &bst2d->nodes[i];
+    bstFreeRec(bst2d, n->left, freeValue);
+    bstFreeRec(bst2d, n->right, freeValue);
     if (freeValue)
         free(n->value);
-    free(n);
+    Bucket *dups = nodeDups(bst2d, i);
+    if (dups != NULL)
+    {
+        for (size_t j = 0; freeValue && j < dups->size; j++)
+            free(dups->entries[j].value);
+        free(dups);
+    }
 }
 
 size_t bst2dSize(BST2d *bst2d)
@@ -192,140 +857,576 @@ size_t bst2dSize(BST2d *bst2d)
 
 bool bst2dInsert(BST2d *b2d, Point *point, void *value)
 {
-    if (b2d->root == NULL)
+    if (b2d->size == MAX_ELEMENTS)
+    {
+        printf("bst2dInsert: too many elements\n");
+        return false;
+    }
+    // the node that may be created is reserved first, so that the array of
+    // the nodes does not move once the path is followed
+    if (!nodesReserve(b2d, 1))
+        return false;
+
+    // the new position belongs to every subtree on its path, and a node at
+    // the same position, if any, is on this path
+    double x = ptGetx(point), y = ptGety(point);
+    NodeIndex *link = pathUpdate(b2d, x, y, true);
+    if (*link != NIL)
     {
-        b2d->root = bnNew(point, value);
-        if (b2d->root == NULL)
+        // the position is already present: the element joins its bucket
+        if (!bucketAppend(b2d, *link, point, value))
         {
+            pathUpdate(b2d, x, y, false);
             return false;
         }
-        b2d->size++;
-        return true;
+        b2d->nodes[*link].size++;
+    }
+    else
+    {
+        NodeIndex n = bnNew(b2d, point, value);
+        *link = n;
+        b2d->nnodes++;
     }
-    BNode *prev = NULL;
-    BNode *n = b2d->root;
-    int depth = -1;
-    while (n != NULL)
+    b2d->size++;
+    return true;
+}
+
+NodeIndex *pathUpdate(BST2d *b2d, double x, double y, bool add)
+{
+    // each iteration goes down a level splitting on x, then a level
+    // splitting on y
+    BNode *nodes = b2d->nodes;
+    NodeIndex *link = &b2d->root;
+    while (*link != NIL && !isAt(&nodes[*link], x, y))
     {
-        prev = n;
-        int cmp = compare(point, n->point, ++depth);
-        if (cmp <= 0)
+        BNode *n = &nodes[*link];
+        if (add)
+        {
+            boxExtend(n, x, y);
+            n->size++;
+        }
+        else
+        {
+            n->size--;
+        }
+        link = (x <= n->point.x) ? &n->left : &n->right;
+        if (*link == NIL || isAt(&nodes[*link], x, y))
+            break;
+
+        n = &nodes[*link];
+        if (add)
         {
-            n = n->left;
+            boxExtend(n, x, y);
+            n->size++;
         }
-        else if (cmp > 0)
+        else
         {
-            n = n->right;
+            n->size--;
         }
+        link = (y <= n->point.y) ? &n->left : &n->right;
     }
-    BNode *new = bnNew(point, value);
-    if (new == NULL)
+    return link;
+}
+
+NodeIndex nodeFind(BST2d *b2d, double x, double y)
+{
+    // each iteration goes down a level splitting on x, then a level
+    // splitting on y: there is no axis to choose in the loop
+    BNode *nodes = b2d->nodes;
+    NodeIndex n = b2d->root;
+    while (n != NIL)
     {
-        return false;
+        if (isAt(&nodes[n], x, y))
+            return n;
+        n = (x <= nodes[n].point.x) ? nodes[n].left : nodes[n].right;
+        if (n == NIL)
+            break;
+        if (isAt(&nodes[n], x, y))
+            return n;
+        n = (y <= nodes[n].point.y) ? nodes[n].left : nodes[n].right;
+    }
+    return NIL;
+}
+
+float floatBelow(double v)
+{
+    // the conversion of a double beyond the range of the floats is undefined
+    if (v > FLT_MAX)
+        return FLT_MAX;
+    if (v < -FLT_MAX)
+        return -INFINITY;
+    float f = (float)v;
+    return ((double)f > v) ? nextafterf(f, -INFINITY) : f;
+}
+
+float floatAbove(double v)
+{
+    if (v > FLT_MAX)
+        return INFINITY;
+    if (v < -FLT_MAX)
+        return -FLT_MAX;
+    float f = (float)v;
+    return ((double)f < v) ? nextafterf(f, INFINITY) : f;
+}
+
+void boxReset(BNode *n)
+{
+    n->xmin = floatBelow(n->point.x);
+    n->xmax = floatAbove(n->point.x);
+    n->ymin = floatBelow(n->point.y);
+    n->ymax = floatAbove(n->point.y);
+}
+
+void boxExtend(BNode *n, double x, double y)
+{
+    if (x < n->xmin)
+        n->xmin = floatBelow(x);
+    if (x > n->xmax)
+        n->xmax = floatAbove(x);
+    if (y < n->ymin)
+        n->ymin = floatBelow(y);
+    if (y > n->ymax)
+        n->ymax = floatAbove(y);
+}
+
+Bucket *nodeDups(BST2d *b2d, NodeIndex n)
+{
+    return (b2d->dups == NULL) ? NULL : b2d->dups[n];
+}
+
+size_t nodeCount(BST2d *b2d, NodeIndex n)
+{
+    Bucket *dups = nodeDups(b2d, n);
+    return (dups == NULL) ? 1 : 1 + dups->size;
+}
+
+bool bucketAppend(BST2d *b2d, NodeIndex n, Point *point, void *value)
+{
+    if (b2d->dups == NULL)
+    {
+        b2d->dups = calloc(b2d->capacity, sizeof(Bucket *));
+        if (b2d->dups == NULL)
+        {
+            printf("bucketAppend: allocation error\n");
+            return false;
+        }
     }
-    new->parent = prev;
-    if (compare(point, prev->point, depth) <= 0)
+    Bucket *dups = b2d->dups[n];
+    if (dups == NULL || dups->size == dups->capacity)
     {
-        prev->left = new;
+        size_t capacity = (dups == NULL) ? 3 : 2 * dups->capacity + 1;
+        Bucket *b = realloc(dups, sizeof(Bucket) + capacity * sizeof(Dup));
+        if (b == NULL)
+        {
+            printf("bucketAppend: allocation error\n");
+            return false;
+        }
+        if (dups == NULL)
+            b->size = 0;
+        b->capacity = capacity;
+        b2d->dups[n] = dups = b;
     }
-    else
+    dups->entries[dups->size].point = *point;
+    dups->entries[dups->size].value = value;
+    dups->size++;
+    return true;
+}
+
+bool nodeVisit(BST2d *b2d, NodeIndex n, bool visit(void *, void *), void *ctx)
+{
+    if (!visit(b2d->nodes[n].value, ctx))
+        return false;
+    Bucket *dups = nodeDups(b2d, n);
+    if (dups != NULL)
     {
-        prev->right = new;
+        for (size_t i = 0; i < dups->size; i++)
+        {
+            if (!visit(dups->entries[i].value, ctx))
+                return false;
+        }
     }
-    b2d->size++;
     return true;
 }
 
-int compare(Point *p1, Point *p2, size_t depth)
+void nodeUpdate(BST2d *b2d, NodeIndex i)
 {
-    if (depth % 2 == 0)
+    BNode *n = &b2d->nodes[i];
+    n->size = (uint32_t)nodeCount(b2d, i);
+    boxReset(n);
+    NodeIndex children[2] = {n->left, n->right};
+    for (size_t i = 0; i < 2; i++)
     {
-        double x1 = ptGetx(p1);
-        double x2 = ptGetx(p2);
-        if (x1 < x2)
+        if (children[i] == NIL)
+            continue;
+        BNode *child = &b2d->nodes[children[i]];
+        n->size += child->size;
+        boxExtend(n, child->xmin, child->ymin);
+        boxExtend(n, child->xmax, child->ymax);
+    }
+}
+
+NodeIndex maxOnAxis(BST2d *b2d, NodeIndex i, size_t depth, size_t axis,
+                    NodeIndex best)
+{
+    // the right children are followed by the loop: only the left subtrees
+    // of the nodes splitting on the other axis need a recursive call
+    while (i != NIL)
+    {
+        BNode *n = &b2d->nodes[i];
+        if (best != NIL)
         {
-            return -1;
+            BNode *b = &b2d->nodes[best];
+            double bestCoord = axis == 0 ? b->point.x : b->point.y;
+            if ((axis == 0 ? n->xmax : n->ymax) <= bestCoord)
+                return best;
         }
-        else if (x1 > x2)
+        double coord = axis == 0 ? n->point.x : n->point.y;
+        if (best == NIL ||
+            coord > (axis == 0 ? b2d->nodes[best].point.x : b2d->nodes[best].point.y))
         {
-            return +1;
+            best = i;
         }
+        // the left subtree of a node splitting on the axis is not larger
+        if (depth % 2 != axis)
+            best = maxOnAxis(b2d, n->left, depth + 1, axis, best);
+        i = n->right;
+        depth++;
     }
+    return best;
+}
 
-    else
+bool bst2dRemove(BST2d *b2d, Point *point, void *value)
+{
+    double x = ptGetx(point), y = ptGety(point);
+    NodeIndex i = nodeFind(b2d, x, y);
+    if (i == NIL)
+        return false;
+
+    BNode *n = &b2d->nodes[i];
+    Bucket *dups = nodeDups(b2d, i);
+    if (dups != NULL)
     {
-        double y1 = ptGety(p1);
-        double y2 = ptGety(p2);
-        if (y1 < y2)
+        // the node stays in the tree: the last element of its bucket takes
+        // the place of the removed one, and the boxes do not change
+        size_t j = 0;
+        while (j < dups->size && dups->entries[j].value != value)
+            j++;
+        if (n->value != value && j == dups->size)
+            return false;
+        Dup last = dups->entries[--dups->size];
+        if (n->value == value)
+        {
+            n->point = last.point;
+            n->value = last.value;
+        }
+        else
         {
-            return -1;
+            dups->entries[j] = last;
         }
-        else if (y1 > y2)
+        if (dups->size == 0)
         {
-            return +1;
+            free(dups);
+            b2d->dups[i] = NULL;
         }
+        pathUpdate(b2d, x, y, false);
+        n->size--;
+        b2d->size--;
+        return true;
     }
+    if (n->value != value)
+        return false;
+
+    if (!nodeRemove(b2d, x, y))
+        return false;
+    b2d->size--;
+    b2d->nnodes--;
+    return true;
+}
 
-    return 0;
+bool pathPush(Path *path, NodeIndex n, bool replaced)
+{
+    if (path->length == path->capacity)
+    {
+        size_t capacity = (path->capacity == 0) ? 64 : 2 * path->capacity;
+        Step *steps = realloc(path->steps, capacity * sizeof(Step));
+        if (steps == NULL)
+        {
+            printf("pathPush: allocation error\n");
+            return false;
+        }
+        path->steps = steps;
+        path->capacity = capacity;
+    }
+    path->steps[path->length].node = n;
+    path->steps[path->length].replaced = replaced;
+    path->length++;
+    return true;
 }
 
-void *bst2dSearch(BST2d *b2d, Point *q)
+bool nodeRemove(BST2d *b2d, double x, double y)
 {
-    if (b2d->root == NULL)
+    BNode *nodes = b2d->nodes;
+    Path path = {NULL, 0, 0};
+
+    // the path goes down to the position (tx, ty): first the one removed,
+    // then the one of the element replacing it, and so on
+    double tx = x, ty = y;
+    NodeIndex i = b2d->root;
+    for (size_t depth = 0;; depth++)
     {
-        return NULL;
+        BNode *n = &nodes[i];
+        bool target = isAt(n, tx, ty);
+        bool leaf = n->left == NIL && n->right == NIL;
+        if (!pathPush(&path, i, target && !leaf))
+        {
+            free(path.steps);
+            return false;
+        }
+        if (target && leaf)
+            break;
+        if (target)
+        {
+            // the element of n is replaced by the one of its subtree with
+            // the largest coordinate on its axis. Taking it from the left
+            // subtree keeps the left side <= the split; when there is none,
+            // the right subtree is moved to the left (below).
+            i = (n->left != NIL) ? n->left : n->right;
+            BNode *m = &nodes[maxOnAxis(b2d, i, depth + 1, depth % 2, NIL)];
+            tx = m->point.x;
+            ty = m->point.y;
+        }
+        else
+        {
+            // positions equal to a node on its axis are always on its left
+            bool left = (depth % 2 == 0) ? tx <= n->point.x : ty <= n->point.y;
+            i = left ? n->left : n->right;
+        }
     }
-    BNode *n = b2d->root;
-    int depth = -1; 
-    int cmp;
-    bool equal = false;
-    while ((!equal) && n != NULL)
-    {
-        cmp = compare(q, n->point, ++depth);
-        if (cmp == 0)
-            if (Equal(q, n->point, depth)) 
-                equal = true;
-        if (!equal && cmp <= 0)
+
+    // each replaced node takes the element of the next replaced node of the
+    // path, the last one taking the element of the leaf
+    NodeIndex prev = NIL;
+    for (size_t k = 0; k < path.length; k++)
+    {
+        i = path.steps[k].node;
+        if (!path.steps[k].replaced && k + 1 < path.length)
+            continue;
+        if (prev != NIL)
         {
-            n = n->left;
+            nodes[prev].point = nodes[i].point;
+            nodes[prev].value = nodes[i].value;
+            if (b2d->dups != NULL)
+            {
+                b2d->dups[prev] = b2d->dups[i];
+                b2d->dups[i] = NULL;
+            }
         }
-        else if (cmp > 0)
+        if (path.steps[k].replaced && nodes[i].left == NIL)
         {
-            n = n->right;
+            nodes[i].left = nodes[i].right;
+            nodes[i].right = NIL;
         }
+        prev = i;
     }
-    if (n == NULL)
+
+    // the leaf is unlinked, and the sizes and the boxes are recomputed from
+    // the bottom of the path
+    NodeIndex leaf = path.steps[path.length - 1].node;
+    if (path.length == 1)
     {
-        return NULL;
+        b2d->root = NIL;
+    }
+    else
+    {
+        BNode *parent = &nodes[path.steps[path.length - 2].node];
+        if (parent->left == leaf)
+            parent->left = NIL;
+        else
+            parent->right = NIL;
+    }
+    bnRelease(b2d, leaf);
+    for (size_t k = path.length - 1; k-- > 0;)
+        nodeUpdate(b2d, path.steps[k].node);
+    free(path.steps);
+    return true;
+}
+
+double boxSqrDistance(BNode *n, Point *q)
+{
+    double x = ptGetx(q), y = ptGety(q);
+    double dx = (x < n->xmin) ? n->xmin - x : ((x > n->xmax) ? x - n->xmax : 0.0);
+    double dy = (y < n->ymin) ? n->ymin - y : ((y > n->ymax) ? y - n->ymax : 0.0);
+    return dx * dx + dy * dy;
+}
+
+double boxSqrMaxDistance(BNode *n, Point *q)
+{
+    double x = ptGetx(q), y = ptGety(q);
+    double dx = (x - n->xmin > n->xmax - x) ? x - n->xmin : n->xmax - x;
+    double dy = (y - n->ymin > n->ymax - y) ? y - n->ymin : n->ymax - y;
+    return dx * dx + dy * dy;
+}
+
+void *bst2dSearch(BST2d *b2d, Point *q)
+{
+    NodeIndex n = nodeFind(b2d, ptGetx(q), ptGety(q));
+    return (n == NIL) ? NULL : b2d->nodes[n].value;
+}
+
+bool bst2dSearchBatch(BST2d *b2d, Point **points, size_t n, void **values)
+{
+    size_t *queries = malloc(n * sizeof(size_t));
+    if (n > 0 && queries == NULL)
+    {
+        printf("bst2dSearchBatch: allocation error\n");
+        return false;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        values[i] = NULL;
+        queries[i] = i;
+    }
+    searchBatchX(b2d, b2d->root, points, queries, n, values);
+    free(queries);
+    return true;
+}
+
+void searchBatchX(BST2d *bst2d, NodeIndex i, Point **points, size_t *queries,
+                  size_t m, void **values)
+{
+    // the queries that are not found keep their NULL result
+    if (i == NIL || m == 0)
+        return;
+    // [0, nleft[ goes left, [nleft, j[ goes right, [j, m[ is left to sort,
+    // and the queries found at n are dropped from the group
+    BNode *n = &bst2d->nodes[i];
+    size_t nleft = 0, j = 0;
+    while (j < m)
+    {
+        Point *q = points[queries[j]];
+        double x = ptGetx(q);
+        if (isAt(n, x, ptGety(q)))
+        {
+            values[queries[j]] = n->value;
+            queries[j] = queries[--m];
+        }
+        else if (x <= n->point.x)
+        {
+            size_t tmp = queries[nleft];
+            queries[nleft++] = queries[j];
+            queries[j++] = tmp;
+        }
+        else
+        {
+            j++;
+        }
     }
-    return n->value;
+    searchBatchY(bst2d, n->left, points, queries, nleft, values);
+    searchBatchY(bst2d, n->right, points, queries + nleft, m - nleft, values);
 }
 
-bool Equal(Point *p1, Point *p2, size_t depth)
+void searchBatchY(BST2d *bst2d, NodeIndex i, Point **points, size_t *queries,
+                  size_t m, void **values)
 {
-    if (depth % 2 == 0)
+    if (i == NIL || m == 0)
+        return;
+    BNode *n = &bst2d->nodes[i];
+    size_t nleft = 0, j = 0;
+    while (j < m)
     {
-        //compare y
-        double y1 = ptGety(p1);
-        double y2 = ptGety(p2);
-        if (y1 == y2)
+        Point *q = points[queries[j]];
+        double y = ptGety(q);
+        if (isAt(n, ptGetx(q), y))
+        {
+            values[queries[j]] = n->value;
+            queries[j] = queries[--m];
+        }
+        else if (y <= n->point.y)
+        {
+            size_t tmp = queries[nleft];
+            queries[nleft++] = queries[j];
+            queries[j++] = tmp;
+        }
+        else
         {
-            return true;
+            j++;
         }
     }
+    searchBatchX(bst2d, n->left, points, queries, nleft, values);
+    searchBatchX(bst2d, n->right, points, queries + nleft, m - nleft, values);
+}
 
-    else
+void bst2dSearchInterleaved(BST2d *b2d, Point **points, size_t n, void **values)
+{
+    // the lanes are at different depths, as each one restarts from the
+    // root when its search is over: the axis of the node of a lane is kept
+    // with it, instead of splitting the loop into x and y levels as
+    // nodeFind does, which would hold every lane at the same parity
+    BNode *nodes[SEARCH_LANES]; // node to compare to in each lane
+    bool onY[SEARCH_LANES]; // whether that node splits on y
+    size_t queries[SEARCH_LANES]; // index of the query of each lane
+    size_t nlanes = 0, next = 0;
+
+    for (size_t i = 0; i < n; i++)
+        values[i] = NULL;
+    if (b2d->root == NIL)
+        return;
+    BNode *root = &b2d->nodes[b2d->root];
+    for (; nlanes < SEARCH_LANES && next < n; nlanes++)
+    {
+        queries[nlanes] = next++;
+        nodes[nlanes] = root;
+        onY[nlanes] = false;
+    }
+
+    while (nlanes > 0)
     {
-        //compare x
-        double x1 = ptGetx(p1);
-        double x2 = ptGetx(p2);
-        if (x1 == x2)
+        // the nodes, with their positions, were prefetched at the previous
+        // step
+        size_t i = 0;
+        while (i < nlanes)
         {
-            return true;
+            BNode *node = nodes[i];
+            NodeIndex child = NIL;
+            double x = ptGetx(points[queries[i]]);
+            double y = ptGety(points[queries[i]]);
+            if (isAt(node, x, y))
+                values[queries[i]] = node->value;
+            else if (onY[i] ? y <= node->point.y : x <= node->point.x)
+                child = node->left;
+            else
+                child = node->right;
+
+            if (child == NIL)
+            {
+                // the search of the lane is over: it starts the next query,
+                // or the last lane (not yet advanced) takes its place
+                if (next == n)
+                {
+                    nlanes--;
+                    queries[i] = queries[nlanes];
+                    nodes[i] = nodes[nlanes];
+                    onY[i] = onY[nlanes];
+                    continue;
+                }
+                queries[i] = next++;
+                nodes[i] = root;
+                onY[i] = false;
+            }
+            else
+            {
+                nodes[i] = &b2d->nodes[child];
+                onY[i] = !onY[i];
+            }
+            PREFETCH(nodes[i]);
+            i++;
         }
     }
+}
 
-    return false;
+bool collect(void *value, void *l)
+{
+    return listInsertLast(l, value);
 }
 
 List *bst2dBallSearch(BST2d *bst2d, Point *q, double r)
@@ -335,15 +1436,7 @@ List *bst2dBallSearch(BST2d *bst2d, Point *q, double r)
     {
         return NULL;
     }
-    if (bst2d->root == NULL)
-    {
-        return list;
-    }
-
-    bool error = false;
-    BNode *n = bst2d->root;
-    bst2dBallSearchRec(n, q, r, 0, list, &error);
-    if (error) 
+    if (!bst2dBallVisit(bst2d, q, r, collect, list))
     {
         listFree(list, false);
         return NULL;
@@ -351,98 +1444,237 @@ List *bst2dBallSearch(BST2d *bst2d, Point *q, double r)
     return list;
 }
 
-void bst2dBallSearchRec(BNode *n, Point *q, double r, size_t depth, List *list, bool *error)
+bool bst2dBallVisit(BST2d *bst2d, Point *q, double r,
+                    bool visit(void *value, void *ctx), void *ctx)
+{
+    return ballVisitX(bst2d, bst2d->root, q, r, visit, ctx);
+}
+
+bool ballVisitX(BST2d *bst2d, NodeIndex i, Point *q, double r, bool visit(void *, void *), void *ctx)
 {
-    if (n == NULL)
+    // prune the subtrees whose bounding box does not intersect the ball
+    BNode *n = &bst2d->nodes[i];
+    if (i == NIL || boxSqrDistance(n, q) > (r*r))
     {
-        return;
+        return true;
     }
 
-    if (ptSqrDistance(n->point, q) <= (r*r))
+    // the ball covers the whole subtree: no more test is needed
+    if (boxSqrMaxDistance(n, q) <= (r*r))
     {
-        *error = *error || !listInsertLast(list, n->value);
+        return bst2dVisitAllRec(bst2d, i, visit, ctx);
+    }
+
+    if (ptSqrDistance(&n->point, q) <= (r*r) && !nodeVisit(bst2d, i, visit, ctx))
+    {
+        return false;
     }
-    
-    // call its successors if in interval of possible values
-    if (continueLeft(n->point, q, r, depth))
+
+    // call its successors if in interval of possible values. The gap to
+    // the splitting line is squared as in ptSqrDistance, so that a point at
+    // a distance of exactly r is not pruned by rounding
+    double gap = ptGetx(q) - n->point.x;
+    if ((gap <= 0 || gap * gap <= (r*r)) && !ballVisitY(bst2d, n->left, q, r, visit, ctx))
     {
-        bst2dBallSearchRec(n->left, q, r, depth + 1, list, error);
+        return false;
     }
-    if (continueRight(n->point, q, r, depth))
+    if (gap >= 0 || gap * gap <= (r*r))
     {
-        bst2dBallSearchRec(n->right, q, r, depth + 1, list, error);
+        return ballVisitY(bst2d, n->right, q, r, visit, ctx);
     }
+    return true;
 }
 
-bool continueLeft(Point *p1, Point *p2, double r, size_t depth)
+bool ballVisitY(BST2d *bst2d, NodeIndex i, Point *q, double r, bool visit(void *, void *), void *ctx)
 {
-    if (depth % 2 == 0)
+    BNode *n = &bst2d->nodes[i];
+    if (i == NIL || boxSqrDistance(n, q) > (r*r))
     {
-        //compare x
-        double x1 = ptGetx(p1);
-        double x2 = ptGetx(p2);
-        if (x2 - r <= x1)
-        {
-            return true;
-        }
+        return true;
+    }
+    if (boxSqrMaxDistance(n, q) <= (r*r))
+    {
+        return bst2dVisitAllRec(bst2d, i, visit, ctx);
     }
+    if (ptSqrDistance(&n->point, q) <= (r*r) && !nodeVisit(bst2d, i, visit, ctx))
+    {
+        return false;
+    }
+    double gap = ptGety(q) - n->point.y;
+    if ((gap <= 0 || gap * gap <= (r*r)) && !ballVisitX(bst2d, n->left, q, r, visit, ctx))
+    {
+        return false;
+    }
+    if (gap >= 0 || gap * gap <= (r*r))
+    {
+        return ballVisitX(bst2d, n->right, q, r, visit, ctx);
+    }
+    return true;
+}
 
-    else
+bool bst2dVisitAllRec(BST2d *bst2d, NodeIndex i, bool visit(void *, void *), void *ctx)
+{
+    while (i != NIL)
     {
-        //compare y
-        double y1 = ptGety(p1);
-        double y2 = ptGety(p2);
-        if (y2 - r <= y1)
-        {
-            return true;
-        }
+        BNode *n = &bst2d->nodes[i];
+        if (!nodeVisit(bst2d, i, visit, ctx) || !bst2dVisitAllRec(bst2d, n->left, visit, ctx))
+            return false;
+        i = n->right;
+    }
+    return true;
+}
+
+size_t bst2dBallCount(BST2d *bst2d, Point *q, double r)
+{
+    return ballCountX(bst2d, bst2d->root, q, r);
+}
+
+size_t ballCountX(BST2d *bst2d, NodeIndex i, Point *q, double r)
+{
+    BNode *n = &bst2d->nodes[i];
+    if (i == NIL || boxSqrDistance(n, q) > (r*r))
+    {
+        return 0;
+    }
+    if (boxSqrMaxDistance(n, q) <= (r*r))
+    {
+        return n->size;
+    }
+    size_t count = (ptSqrDistance(&n->point, q) <= (r*r)) ? nodeCount(bst2d, i) : 0;
+    double gap = ptGetx(q) - n->point.x;
+    if (gap <= 0 || gap * gap <= (r*r))
+    {
+        count += ballCountY(bst2d, n->left, q, r);
+    }
+    if (gap >= 0 || gap * gap <= (r*r))
+    {
+        count += ballCountY(bst2d, n->right, q, r);
     }
+    return count;
+}
 
-    return false;
+size_t ballCountY(BST2d *bst2d, NodeIndex i, Point *q, double r)
+{
+    BNode *n = &bst2d->nodes[i];
+    if (i == NIL || boxSqrDistance(n, q) > (r*r))
+    {
+        return 0;
+    }
+    if (boxSqrMaxDistance(n, q) <= (r*r))
+    {
+        return n->size;
+    }
+    size_t count = (ptSqrDistance(&n->point, q) <= (r*r)) ? nodeCount(bst2d, i) : 0;
+    double gap = ptGety(q) - n->point.y;
+    if (gap <= 0 || gap * gap <= (r*r))
+    {
+        count += ballCountX(bst2d, n->left, q, r);
+    }
+    if (gap >= 0 || gap * gap <= (r*r))
+    {
+        count += ballCountX(bst2d, n->right, q, r);
+    }
+    return count;
 }
 
-bool continueRight(Point *p1, Point *p2, double r, size_t depth)
+List *bst2dKNearest(BST2d *bst2d, Point *q, size_t k)
 {
-    if (depth % 2 == 0)
+    // no more than the stored positions can be returned: the heap is sized
+    // for them, whatever k is
+    if (k > bst2d->size)
+        k = bst2d->size;
+    Heap *heap = heapNew(k);
+    if (heap == NULL)
     {
-        double x1 = ptGetx(p1);
-        double x2 = ptGetx(p2);
-        if (x2 + r > x1)
-        {
-            return true;
-        }
+        return NULL;
     }
 
-    else
+    bool error = false;
+    if (k > 0)
     {
-        //compare y
-        double y1 = ptGety(p1);
-        double y2 = ptGety(p2);
-        if (y2 + r > y1)
-        {
-            return true;
-        }
+        kNearestX(bst2d, bst2d->root, q, k, heap, &error);
+    }
+    List *list = error ? NULL : heapToSortedList(heap);
+    heapFree(heap);
+    return list;
+}
+
+bool nodeOffer(BST2d *bst2d, NodeIndex i, Point *q, size_t k, Heap *heap)
+{
+    BNode *n = &bst2d->nodes[i];
+    double d = ptSqrDistance(&n->point, q);
+    if (!heapOfferBounded(heap, k, d, n->value))
+        return false;
+    Bucket *dups = nodeDups(bst2d, i);
+    for (size_t j = 0; dups != NULL && j < dups->size; j++)
+    {
+        if (!heapOfferBounded(heap, k, d, dups->entries[j].value))
+            return false;
+    }
+    return true;
+}
+
+void kNearestX(BST2d *bst2d, NodeIndex i, Point *q, size_t k, Heap *heap, bool *error)
+{
+    if (i == NIL || *error)
+    {
+        return;
     }
+    *error = !nodeOffer(bst2d, i, q, k, heap);
 
-    return false;
+    // side of the splitting line where q lies
+    BNode *n = &bst2d->nodes[i];
+    bool left = ptGetx(q) <= n->point.x;
+    NodeIndex near = left ? n->left : n->right;
+    NodeIndex far = left ? n->right : n->left;
+
+    kNearestY(bst2d, near, q, k, heap, error);
+    if (far != NIL && (heapSize(heap) < k || boxSqrDistance(&bst2d->nodes[far], q) <= heapMaxPriority(heap)))
+    {
+        kNearestY(bst2d, far, q, k, heap, error);
+    }
+}
+
+void kNearestY(BST2d *bst2d, NodeIndex i, Point *q, size_t k, Heap *heap, bool *error)
+{
+    if (i == NIL || *error)
+    {
+        return;
+    }
+    *error = !nodeOffer(bst2d, i, q, k, heap);
+
+    BNode *n = &bst2d->nodes[i];
+    bool left = ptGety(q) <= n->point.y;
+    NodeIndex near = left ? n->left : n->right;
+    NodeIndex far = left ? n->right : n->left;
+
+    kNearestX(bst2d, near, q, k, heap, error);
+    if (far != NIL && (heapSize(heap) < k || boxSqrDistance(&bst2d->nodes[far], q) <= heapMaxPriority(heap)))
+    {
+        kNearestX(bst2d, far, q, k, heap, error);
+    }
+}
+
+bool isAt(BNode *n, double x, double y)
+{
+    return n->point.x == x && n->point.y == y;
 }
 
 double bst2dAverageNodeDepth(BST2d *bst2d)
 {
-    double nodesNumber = (double) bst2d->size;
-    if (nodesNumber == 0 || nodesNumber == 1 || bst2d->root == NULL)
+    double nodesNumber = (double) bst2d->nnodes;
+    if (nodesNumber == 0 || nodesNumber == 1 || bst2d->root == NIL)
 		return nodesNumber;
 
-    BNode *n = bst2d->root;
-    int totalNodeDepth = bst2dDepthRec(n, 0);
+    int totalNodeDepth = bst2dDepthRec(bst2d, bst2d->root, 0);
     return totalNodeDepth / nodesNumber;
 }
 
-int bst2dDepthRec(BNode *n, int totalNodeDepth)
+int bst2dDepthRec(BST2d *bst2d, NodeIndex n, int totalNodeDepth)
 {
-    if (n == NULL)
+    if (n == NIL)
     {
         return 0;
     }
-    return bst2dDepthRec(n->right, totalNodeDepth + 1) + bst2dDepthRec(n->left, totalNodeDepth + 1) + totalNodeDepth;
+    return bst2dDepthRec(bst2d, bst2d->nodes[n].right, totalNodeDepth + 1) + bst2dDepthRec(bst2d, bst2d->nodes[n].left, totalNodeDepth + 1) + totalNodeDepth;
 }
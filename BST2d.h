@@ -25,12 +25,34 @@ typedef struct BST2d_t BST2d;
 
 BST2d *bst2dNew(void);
 
+/* ------------------------------------------------------------------------- *
+ * Creates a BST2d holding the n given position-value pairs (points[i] is
+ * associated to values[i]). Each node splits its subtree on the median of
+ * the alternating x/y coordinate, found with a linear-time selection, so the
+ * height of the tree is about log2(n) whatever the order of the input.
+ *
+ * The BST2d must later be deleted by calling freeBST2d(). The coordinates of
+ * the points are copied in the nodes: the arrays are not modified and may
+ * be freed, with the Point objects, once the function returns.
+ *
+ * PARAMETERS
+ * points         An array of n positions (Point objects)
+ * values         An array of n values
+ * n              The number of position-value pairs
+ *
+ * RETURN
+ * bst2d          A pointer to the BST2d, or NULL in case of error
+ * ------------------------------------------------------------------------- */
+
+BST2d *bst2dBuildFromArrays(Point **points, void **values, size_t n);
+
 /* ------------------------------------------------------------------------- *
  * Frees the allocated memory of the given BST2d.
  *
  * PARAMETERS
  * bst2d          A valid pointer to a BST2d object
- * freeKey        Whether to free the keys.
+ * freeKey        Ignored: the coordinates of the points are copied into the
+ *                nodes, the points given as keys are never kept.
  * freeValue      Whether to free the values.
  *
  * ------------------------------------------------------------------------- */
@@ -51,7 +73,10 @@ size_t bst2dSize(BST2d *bst2d);
 
 /* ------------------------------------------------------------------------- *
  * Inserts a new position-value pair in the provided BST2d. This
- * implementation of the BST allows duplicate keys.
+ * implementation of the BST allows duplicate keys: the elements at the same
+ * position share a single node, so that duplicates do not make the tree
+ * any deeper. The coordinates of the point are copied in the tree, which
+ * does not reference the Point object after the call.
  *
  * PARAMETERS
  * bst2d          A valid pointer to a BST object
@@ -65,6 +90,23 @@ size_t bst2dSize(BST2d *bst2d);
 
 bool bst2dInsert(BST2d *b2d, Point *point, void *value);
 
+/* ------------------------------------------------------------------------- *
+ * Removes an element from the provided BST2d. Since positions may be
+ * duplicated, the element is identified by its position and its value
+ * (compared as a pointer). The value is not freed.
+ *
+ * PARAMETERS
+ * bst2d          A valid pointer to a BST2d object
+ * point          The position of the element
+ * value          The value of the element
+ *
+ * RETURN
+ * res          A boolean equal to true if the element was found and
+ *              removed, false otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bst2dRemove(BST2d *b2d, Point *point, void *value);
+
 /* ------------------------------------------------------------------------- *
  * Returns the value associated to a position, if any. If several values are
  * associated to this position, any one of them is returned.
@@ -80,6 +122,41 @@ bool bst2dInsert(BST2d *b2d, Point *point, void *value);
 
 void *bst2dSearch(BST2d *b2d, Point *q);
 
+/* ------------------------------------------------------------------------- *
+ * Looks for a batch of positions at once, as n calls to bst2dSearch would.
+ * The queries descend the tree in groups, split at each node between its
+ * subtrees, so the nodes shared by several search paths are read once.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST2d object
+ * points       An array of n positions to look for
+ * n            The number of positions
+ * values       An array of n pointers, the i-th one being set to one of the
+ *              values associated to points[i], or NULL if it is not present
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error (values
+ *              is then left unchanged), true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bst2dSearchBatch(BST2d *b2d, Point **points, size_t n, void **values);
+
+/* ------------------------------------------------------------------------- *
+ * Looks for a batch of positions, as n calls to bst2dSearch would. A group
+ * of searches is advanced in lockstep, each step prefetching the next node
+ * of every search, so that their cache misses overlap. Nothing is
+ * allocated: this pays off once the tree no longer fits in the cache.
+ *
+ * PARAMETERS
+ * bst          A valid pointer to a BST2d object
+ * points       An array of n positions to look for
+ * n            The number of positions
+ * values       An array of n pointers, the i-th one being set to one of the
+ *              values associated to points[i], or NULL if it is not present
+ * ------------------------------------------------------------------------- */
+
+void bst2dSearchInterleaved(BST2d *b2d, Point **points, size_t n, void **values);
+
 /* ------------------------------------------------------------------------- *
  * Finds the set of positions (x,y) in the provided BST2d that are included
  * in a ball of radius r and centered at the position q given as argument.
@@ -102,6 +179,64 @@ void *bst2dSearch(BST2d *b2d, Point *q);
 
 List *bst2dBallSearch(BST2d *bst2d, Point *q, double r);
 
+/* ------------------------------------------------------------------------- *
+ * Passes the value of every position of the provided BST2d that is included
+ * in a ball of radius r and centered at the position q to a callback (in no
+ * particular order). No list is built: the search stops as soon as the
+ * callback returns false.
+ *
+ * PARAMETERS
+ * bst2d          A valid pointer to a BST2d object
+ * q              The center of the ball
+ * r              The radius of the ball
+ * visit          The callback, called as visit(value, ctx). It returns true
+ *                to continue the search, false to stop it
+ * ctx            A pointer passed unchanged to the callback
+ *
+ * RETURN
+ * res            A boolean equal to false if the callback stopped the
+ *                search, true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool bst2dBallVisit(BST2d *bst2d, Point *q, double r,
+                    bool visit(void *value, void *ctx), void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the positions of the provided BST2d that are included in a ball of
+ * radius r and centered at the position q. Nothing is allocated, and the
+ * subtrees entirely inside the ball are counted without being walked.
+ *
+ * PARAMETERS
+ * bst2d          A valid pointer to a BST2d object
+ * q              The center of the ball
+ * r              The radius of the ball
+ *
+ * RETURN
+ * nb             The number of positions in the ball
+ * ------------------------------------------------------------------------- */
+
+size_t bst2dBallCount(BST2d *bst2d, Point *q, double r);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the k positions of the provided BST2d that are the closest to the
+ * position q and returns their values, sorted by increasing distance to q.
+ * Ties are broken arbitrarily.
+ *
+ * PARAMETERS
+ * bst2d          A valid pointer to a BST2d object
+ * q              The query position
+ * k              The number of neighbours to look for
+ *
+ * RETURN
+ * l              A List containing the values of the min(k, size) nearest
+ *                positions, or NULL in case of allocation error.
+ *
+ * NOTES
+ * The List must be freed but not its content.
+ * ------------------------------------------------------------------------- */
+
+List *bst2dKNearest(BST2d *bst2d, Point *q, size_t k);
+
 /* ------------------------------------------------------------------------- *
  * Returns the average depth of the BST2d nodes. The depth of a node is the
  * number of edges that connect it to the root (the root's depth is thus 0).
@@ -0,0 +1,1167 @@
+/* ========================================================================= *
+ * BSTTemplate interface:
+ * A binary search tree specialized at compile time for a type of keys. The
+ * generic BST compares its keys through a function pointer, an indirect
+ * call per comparison; here the comparison function is a parameter of the
+ * macro, called directly, so the compiler can inline it.
+ *
+ * The tree is the red-black tree of the generic BST, with its algorithms:
+ * the nodes are stored in one array and linked by 32-bit indices, each
+ * node counts the elements of its subtree, so that a range is counted in
+ * O(log n), and the elements whose key is equal to the key of a node are
+ * kept in a bucket out of the nodes. The keys are stored by value in the
+ * nodes: a comparison reads no other memory than the node.
+ *
+ * A tree that is only searched can be frozen, as the generic BST: its
+ * elements are then also laid out in Eytzinger (breadth-first) order, and
+ * the searches are branch-free descents of that array, with prefetching
+ * (Eytzinger.h).
+ * ========================================================================= */
+
+#ifndef _BSTTEMPLATE_H_
+#define _BSTTEMPLATE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Eytzinger.h"
+
+// number of searches advanced together by the SearchInterleaved functions
+#define BST_LANES 16
+
+// distance, in levels of the frozen array, of the prefetched descendants
+#define BST_AHEAD 8
+
+#if defined(__GNUC__)
+#define BST_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define BST_PREFETCH(p) ((void)(p))
+#endif
+
+// index standing for no node: the slot 0 of the array of the nodes is a
+// zeroed node (black, of size 0) that never belongs to the tree
+#define BST_NIL 0
+
+// number of slots of the array of the nodes that the parent links can
+// address (their 32 bits also hold the color of the node)
+#define BST_MAX_NODES ((((size_t)1) << 31) - 1)
+
+// number of elements that the 32-bit subtree sizes can count
+#define BST_MAX_ELEMENTS ((size_t)UINT32_MAX)
+
+#define BST_BLACK 0
+#define BST_RED 1
+
+/* ------------------------------------------------------------------------- *
+ * Defines the type Name, a tree whose keys are objects of type Key ordered
+ * by compare, called as compare(const Key *a, const Key *b) and returning a
+ * negative, zero or positive value as strcmp. Several elements may have
+ * equal keys. The macro is meant to be expanded in the .c file using the
+ * tree: the functions are static, and are the following.
+ *
+ * Name *NameNew(void)
+ *     Creates an empty tree. Returns NULL in case of allocation error. The
+ *     tree must later be deleted by calling NameFree().
+ *
+ * Name *NameBuildFromArrays(const Key *keys, void **values, size_t n)
+ *     Creates a tree holding the n given key-value pairs (the keys are
+ *     copied), balanced without any rotation. Returns NULL in case of
+ *     allocation error.
+ *
+ * void NameFree(Name *t)
+ *     Frees the tree (not the values).
+ *
+ * size_t NameSize(Name *t)
+ *     Returns the number of elements of the tree.
+ *
+ * bool NameFreeze(Name *t)
+ *     Lays out a copy of the elements in Eytzinger order, which
+ *     NameSearch, NameSearchBatch, NameSearchInterleaved and NameRangeVisit
+ *     then walk instead of the nodes. Returns false in case of allocation
+ *     error, the tree being then left as it was.
+ *
+ * bool NameInsert(Name *t, const Key *key, void *value)
+ *     Inserts an element (the key is copied), thawing the tree. Returns
+ *     false in case of allocation error.
+ *
+ * bool NameRemove(Name *t, const Key *key, void *value)
+ *     Removes the element of key key and value value (compared as a
+ *     pointer), thawing the tree. Returns false if there is no such
+ *     element.
+ *
+ * void *NameSearch(Name *t, const Key *key)
+ *     Returns one of the values associated to key, or NULL if there is none.
+ *
+ * bool NameSearchBatch(Name *t, const Key *keys, size_t n, void **values)
+ *     Sets values[i] to NameSearch(t, &keys[i]) for the n keys. The keys
+ *     are sorted and go down the tree together: each node (or slot of the
+ *     frozen array) is compared once for the whole group of keys reaching
+ *     it. Returns false in case of allocation error.
+ *
+ * void NameSearchInterleaved(Name *t, const Key *keys, size_t n,
+ *                            void **values)
+ *     Sets values[i] to NameSearch(t, &keys[i]) for the n keys, advancing
+ *     the searches in lockstep so that their cache misses overlap.
+ *
+ * bool NameRangeVisit(Name *t, const Key *keyMin, const Key *keyMax,
+ *                     bool visit(const Key *key, void *value, void *ctx),
+ *                     void *ctx)
+ *     Passes the elements whose keys are in [keyMin, keyMax] to visit, in
+ *     the increasing order of the keys, until it returns false. Returns
+ *     false if visit stopped the walk, true otherwise.
+ *
+ * size_t NameRangeCount(Name *t, const Key *keyMin, const Key *keyMax)
+ *     Returns the number of elements whose keys are in [keyMin, keyMax],
+ *     from the sizes of the subtrees on two paths of the tree.
+ *
+ * bool NameVisit(Name *t, bool visit(const Key *key, void *value, void *ctx),
+ *                void *ctx)
+ *     Passes all the elements to visit, in no particular order (the array
+ *     of the nodes is scanned sequentially), until it returns false.
+ * ------------------------------------------------------------------------- */
+
+#define BST_DEFINE(Name, Key, compare)                                        \
+typedef struct Name##_t Name;                                                 \
+typedef struct Name##Entry_t Name##Entry;                                     \
+typedef struct Name##Bucket_t Name##Bucket;                                   \
+typedef struct Name##Node_t Name##Node;                                       \
+struct Name##Entry_t                                                          \
+{                                                                             \
+    Key key;                                                                  \
+    void *value;                                                              \
+};                                                                            \
+/* the elements of a node beyond the first one, whose keys are all equal to   \
+   the key of the node */                                                     \
+struct Name##Bucket_t                                                         \
+{                                                                             \
+    size_t size;                                                              \
+    size_t capacity;                                                          \
+    Name##Entry entries[];                                                    \
+};                                                                            \
+struct Name##Node_t                                                           \
+{                                                                             \
+    uint32_t left;                                                            \
+    uint32_t right;                                                           \
+    unsigned int parent : 31;                                                 \
+    unsigned int color : 1;                                                   \
+    uint32_t size; /* number of elements in the subtree of the node */        \
+    Key key;                                                                  \
+    void *value;                                                              \
+};                                                                            \
+struct Name##_t                                                               \
+{                                                                             \
+    uint32_t root;                                                            \
+    size_t size;                                                              \
+    size_t nnodes; /* number of nodes, i.e. of distinct keys */               \
+    /* storage of the nodes, whose slot 0 is the NIL node. The array may be   \
+       moved when it grows, so the nodes are linked by their indices. */      \
+    Name##Node *nodes;                                                        \
+    size_t capacity; /* number of slots of nodes */                           \
+    size_t used; /* number of slots taken so far, released ones included */   \
+    uint32_t released; /* first released slot, the next ones being linked     \
+                          through their right field (NIL if none) */          \
+    /* other elements with the same key as each node (NULL if none), as       \
+       many slots as nodes, allocated with the first bucket */                \
+    Name##Bucket **dups;                                                      \
+    /* frozen trees: every element in Eytzinger (breadth-first) order, the    \
+       children of slot k being 2k and 2k + 1, slot 0 being unused (NULL      \
+       if not frozen) */                                                      \
+    Key *frozenKeys;                                                          \
+    void **frozenValues;                                                      \
+};                                                                            \
+static inline bool Name##Reserve(Name *t, size_t n)                           \
+{                                                                             \
+    if (n <= t->capacity - t->used)                                           \
+        return true;                                                          \
+    if (n > BST_MAX_NODES - t->used)                                          \
+    {                                                                         \
+        printf(#Name "Reserve: too many nodes\n");                            \
+        return false;                                                         \
+    }                                                                         \
+    /* the array grows by half of its size, within the reach of the           \
+       indices */                                                             \
+    size_t capacity = t->capacity + t->capacity / 2;                          \
+    if (capacity < t->used + n)                                               \
+        capacity = t->used + n;                                               \
+    if (capacity > BST_MAX_NODES)                                             \
+        capacity = BST_MAX_NODES;                                             \
+    if (t->dups != NULL)                                                      \
+    {                                                                         \
+        Name##Bucket **dups = realloc(t->dups,                                \
+                                      capacity * sizeof(Name##Bucket *));     \
+        if (dups == NULL)                                                     \
+        {                                                                     \
+            printf(#Name "Reserve: allocation error\n");                      \
+            return false;                                                     \
+        }                                                                     \
+        for (size_t i = t->capacity; i < capacity; i++)                       \
+            dups[i] = NULL;                                                   \
+        t->dups = dups;                                                       \
+    }                                                                         \
+    Name##Node *nodes = realloc(t->nodes, capacity * sizeof(Name##Node));     \
+    if (nodes == NULL)                                                        \
+    {                                                                         \
+        printf(#Name "Reserve: allocation error\n");                          \
+        return false;                                                         \
+    }                                                                         \
+    t->nodes = nodes;                                                         \
+    t->capacity = capacity;                                                   \
+    return true;                                                              \
+}                                                                             \
+static inline uint32_t Name##NodeNew(Name *t, const Key *key, void *value)    \
+{                                                                             \
+    uint32_t i = t->released;                                                 \
+    if (i != BST_NIL)                                                         \
+        t->released = t->nodes[i].right;                                      \
+    else                                                                      \
+        i = (uint32_t)t->used++;                                              \
+    Name##Node *n = &t->nodes[i];                                             \
+    n->parent = BST_NIL;                                                      \
+    n->left = BST_NIL;                                                        \
+    n->right = BST_NIL;                                                       \
+    n->key = *key;                                                            \
+    n->value = value;                                                         \
+    n->color = BST_RED;                                                       \
+    n->size = 1;                                                              \
+    return i;                                                                 \
+}                                                                             \
+static inline void Name##NodeRelease(Name *t, uint32_t i)                     \
+{                                                                             \
+    /* a released node has a size of 0, which NameVisit skips */              \
+    t->nodes[i].size = 0;                                                     \
+    t->nodes[i].right = t->released;                                          \
+    t->released = i;                                                          \
+}                                                                             \
+static inline Name *Name##New(void)                                           \
+{                                                                             \
+    Name *t = malloc(sizeof(Name));                                           \
+    Name##Node *nodes = calloc(1, sizeof(Name##Node)); /* the NIL node */     \
+    if (t == NULL || nodes == NULL)                                           \
+    {                                                                         \
+        printf(#Name "New: allocation error\n");                              \
+        free(t);                                                              \
+        free(nodes);                                                          \
+        return NULL;                                                          \
+    }                                                                         \
+    t->nodes = nodes;                                                         \
+    t->capacity = 1;                                                          \
+    t->used = 1;                                                              \
+    t->released = BST_NIL;                                                    \
+    t->root = BST_NIL;                                                        \
+    t->size = 0;                                                              \
+    t->nnodes = 0;                                                            \
+    t->dups = NULL;                                                           \
+    t->frozenKeys = NULL;                                                     \
+    t->frozenValues = NULL;                                                   \
+    return t;                                                                 \
+}                                                                             \
+static inline void Name##Thaw(Name *t)                                        \
+{                                                                             \
+    free(t->frozenKeys);                                                      \
+    free(t->frozenValues);                                                    \
+    t->frozenKeys = NULL;                                                     \
+    t->frozenValues = NULL;                                                   \
+}                                                                             \
+static inline size_t Name##FrozenLowerBound(Name *t, const Key *key)          \
+{                                                                             \
+    size_t n = t->size;                                                       \
+    size_t k = 1;                                                             \
+    while (k <= n)                                                            \
+    {                                                                         \
+        if (BST_AHEAD * k <= n)                                               \
+            BST_PREFETCH(&t->frozenKeys[BST_AHEAD * k]);                      \
+        k = 2 * k + (compare(&t->frozenKeys[k], key) < 0);                    \
+    }                                                                         \
+    return eytzingerLowerBound(k);                                            \
+}                                                                             \
+static inline Name##Bucket *Name##Dups(Name *t, uint32_t n)                   \
+{                                                                             \
+    return (t->dups == NULL) ? NULL : t->dups[n];                             \
+}                                                                             \
+static inline size_t Name##Count(Name *t, uint32_t n)                         \
+{                                                                             \
+    Name##Bucket *dups = Name##Dups(t, n);                                    \
+    return (dups == NULL) ? 1 : 1 + dups->size;                               \
+}                                                                             \
+static inline void Name##Element(Name *t, uint32_t n, size_t i,               \
+                                 const Key **key, void **value)               \
+{                                                                             \
+    if (i == 0)                                                               \
+    {                                                                         \
+        *key = &t->nodes[n].key;                                              \
+        *value = t->nodes[n].value;                                           \
+    }                                                                         \
+    else                                                                      \
+    {                                                                         \
+        *key = &t->dups[n]->entries[i - 1].key;                               \
+        *value = t->dups[n]->entries[i - 1].value;                            \
+    }                                                                         \
+}                                                                             \
+static inline bool Name##BucketAppend(Name *t, uint32_t n, const Key *key,    \
+                                      void *value)                            \
+{                                                                             \
+    if (t->dups == NULL)                                                      \
+    {                                                                         \
+        t->dups = calloc(t->capacity, sizeof(Name##Bucket *));                \
+        if (t->dups == NULL)                                                  \
+        {                                                                     \
+            printf(#Name "BucketAppend: allocation error\n");                 \
+            return false;                                                     \
+        }                                                                     \
+    }                                                                         \
+    Name##Bucket *dups = t->dups[n];                                          \
+    if (dups == NULL || dups->size == dups->capacity)                         \
+    {                                                                         \
+        size_t capacity = (dups == NULL) ? 3 : 2 * dups->capacity + 1;        \
+        Name##Bucket *b = realloc(dups, sizeof(Name##Bucket)                  \
+                                        + capacity * sizeof(Name##Entry));    \
+        if (b == NULL)                                                        \
+        {                                                                     \
+            printf(#Name "BucketAppend: allocation error\n");                 \
+            return false;                                                     \
+        }                                                                     \
+        if (dups == NULL)                                                     \
+            b->size = 0;                                                      \
+        b->capacity = capacity;                                               \
+        t->dups[n] = dups = b;                                                \
+    }                                                                         \
+    dups->entries[dups->size].key = *key;                                     \
+    dups->entries[dups->size].value = value;                                  \
+    dups->size++;                                                             \
+    return true;                                                              \
+}                                                                             \
+static inline size_t Name##NodeSize(Name *t, uint32_t n)                      \
+{                                                                             \
+    /* the NIL node has a size of 0 */                                        \
+    return t->nodes[n].size;                                                  \
+}                                                                             \
+static inline void Name##Sort(Name##Entry *entries, Name##Entry *tmp,         \
+                              size_t n)                                       \
+{                                                                             \
+    if (n < 2)                                                                \
+        return;                                                               \
+    size_t half = n / 2;                                                      \
+    Name##Sort(entries, tmp, half);                                           \
+    Name##Sort(entries + half, tmp, n - half);                                \
+    /* merge both halves in tmp, taking from the left one on ties */          \
+    size_t i = 0, j = half, k = 0;                                            \
+    while (i < half && j < n)                                                 \
+    {                                                                         \
+        if (compare(&entries[j].key, &entries[i].key) < 0)                    \
+            tmp[k++] = entries[j++];                                          \
+        else                                                                  \
+            tmp[k++] = entries[i++];                                          \
+    }                                                                         \
+    while (i < half)                                                          \
+        tmp[k++] = entries[i++];                                              \
+    while (j < n)                                                             \
+        tmp[k++] = entries[j++];                                              \
+    for (k = 0; k < n; k++)                                                   \
+        entries[k] = tmp[k];                                                  \
+}                                                                             \
+static inline uint32_t Name##BuildRec(Name *t, Name##Entry *entries,          \
+                                      size_t *starts, size_t n,               \
+                                      size_t depth, size_t redDepth,          \
+                                      bool *error)                            \
+{                                                                             \
+    if (n == 0 || *error)                                                     \
+        return BST_NIL;                                                       \
+    size_t mid = n / 2;                                                       \
+    Name##Entry *group = entries + starts[mid];                               \
+    uint32_t i = Name##NodeNew(t, &group[0].key, group[0].value);             \
+    Name##Node *node = &t->nodes[i];                                          \
+    for (size_t j = starts[mid] + 1; j < starts[mid + 1]; j++)                \
+    {                                                                         \
+        if (!Name##BucketAppend(t, i, &entries[j].key, entries[j].value))     \
+        {                                                                     \
+            *error = true;                                                    \
+            return BST_NIL;                                                   \
+        }                                                                     \
+    }                                                                         \
+    node->color = (depth == redDepth) ? BST_RED : BST_BLACK;                  \
+    node->left = Name##BuildRec(t, entries, starts, mid, depth + 1,           \
+                                redDepth, error);                             \
+    node->right = Name##BuildRec(t, entries, starts + mid + 1, n - mid - 1,   \
+                                 depth + 1, redDepth, error);                 \
+    node->size = (uint32_t)(starts[n] - starts[0]);                           \
+    if (node->left != BST_NIL)                                                \
+        t->nodes[node->left].parent = i;                                      \
+    if (node->right != BST_NIL)                                               \
+        t->nodes[node->right].parent = i;                                     \
+    return i;                                                                 \
+}                                                                             \
+static inline void Name##Free(Name *t)                                        \
+{                                                                             \
+    /* the nodes are released with their array, only the buckets of           \
+       duplicate keys are freed one by one */                                 \
+    if (t->dups != NULL)                                                      \
+    {                                                                         \
+        for (size_t i = 1; i < t->used; i++)                                  \
+            free(t->dups[i]);                                                 \
+    }                                                                         \
+    Name##Thaw(t);                                                            \
+    free(t->dups);                                                            \
+    free(t->nodes);                                                           \
+    free(t);                                                                  \
+}                                                                             \
+static inline Name *Name##BuildFromArrays(const Key *keys, void **values,     \
+                                          size_t n)                           \
+{                                                                             \
+    if (n > BST_MAX_ELEMENTS)                                                 \
+    {                                                                         \
+        printf(#Name "BuildFromArrays: too many elements\n");                 \
+        return NULL;                                                          \
+    }                                                                         \
+    Name *t = Name##New();                                                    \
+    if (t == NULL)                                                            \
+        return NULL;                                                          \
+    if (n == 0)                                                               \
+        return t;                                                             \
+    Name##Entry *entries = malloc(2 * n * sizeof(Name##Entry));               \
+    size_t *starts = malloc((n + 1) * sizeof(size_t));                        \
+    if (entries == NULL || starts == NULL)                                    \
+    {                                                                         \
+        printf(#Name "BuildFromArrays: allocation error\n");                  \
+        free(entries);                                                        \
+        free(starts);                                                         \
+        Name##Free(t);                                                        \
+        return NULL;                                                          \
+    }                                                                         \
+    for (size_t i = 0; i < n; i++)                                            \
+    {                                                                         \
+        entries[i].key = keys[i];                                             \
+        entries[i].value = values[i];                                         \
+    }                                                                         \
+    Name##Sort(entries, entries + n, n);                                      \
+    /* one node per group of equal keys */                                    \
+    size_t m = 0;                                                             \
+    for (size_t i = 0; i < n; i++)                                            \
+    {                                                                         \
+        if (i == 0 || compare(&entries[i - 1].key, &entries[i].key) != 0)     \
+            starts[m++] = i;                                                  \
+    }                                                                         \
+    starts[m] = n;                                                            \
+    /* the deepest level of a minimum-height tree is at depth                 \
+       floor(log2(m)), it is colored red unless it is full */                 \
+    size_t height = 0;                                                        \
+    while ((((size_t)2) << height) <= m)                                      \
+        height++;                                                             \
+    size_t redDepth = (m == (((size_t)2) << height) - 1) ? height + 1         \
+                                                         : height;            \
+    bool error = !Name##Reserve(t, m);                                        \
+    t->root = Name##BuildRec(t, entries, starts, m, 0, redDepth, &error);     \
+    free(entries);                                                            \
+    free(starts);                                                             \
+    t->size = n;                                                              \
+    t->nnodes = m;                                                            \
+    if (error)                                                                \
+    {                                                                         \
+        Name##Free(t);                                                        \
+        return NULL;                                                          \
+    }                                                                         \
+    return t;                                                                 \
+}                                                                             \
+static inline size_t Name##Size(Name *t)                                      \
+{                                                                             \
+    return t->size;                                                           \
+}                                                                             \
+static inline void Name##LeftRotate(Name *t, uint32_t x)                      \
+{                                                                             \
+    Name##Node *nodes = t->nodes;                                             \
+    Name##Node *xn = &nodes[x];                                               \
+    uint32_t y = xn->right;                                                   \
+    Name##Node *yn = &nodes[y];                                               \
+    xn->right = yn->left;                                                     \
+    if (yn->left != BST_NIL)                                                  \
+        nodes[yn->left].parent = x;                                           \
+    yn->parent = xn->parent;                                                  \
+    if (xn->parent == BST_NIL)                                                \
+        t->root = y;                                                          \
+    else if (x == nodes[xn->parent].left)                                     \
+        nodes[xn->parent].left = y;                                           \
+    else                                                                      \
+        nodes[xn->parent].right = y;                                          \
+    yn->left = x;                                                             \
+    xn->parent = y;                                                           \
+    yn->size = xn->size;                                                      \
+    xn->size = (uint32_t)(Name##Count(t, x) + Name##NodeSize(t, xn->left)     \
+                          + Name##NodeSize(t, xn->right));                    \
+}                                                                             \
+static inline void Name##RightRotate(Name *t, uint32_t x)                     \
+{                                                                             \
+    Name##Node *nodes = t->nodes;                                             \
+    Name##Node *xn = &nodes[x];                                               \
+    uint32_t y = xn->left;                                                    \
+    Name##Node *yn = &nodes[y];                                               \
+    xn->left = yn->right;                                                     \
+    if (yn->right != BST_NIL)                                                 \
+        nodes[yn->right].parent = x;                                          \
+    yn->parent = xn->parent;                                                  \
+    if (xn->parent == BST_NIL)                                                \
+        t->root = y;                                                          \
+    else if (x == nodes[xn->parent].right)                                    \
+        nodes[xn->parent].right = y;                                          \
+    else                                                                      \
+        nodes[xn->parent].left = y;                                           \
+    yn->right = x;                                                            \
+    xn->parent = y;                                                           \
+    yn->size = xn->size;                                                      \
+    xn->size = (uint32_t)(Name##Count(t, x) + Name##NodeSize(t, xn->left)     \
+                          + Name##NodeSize(t, xn->right));                    \
+}                                                                             \
+static inline void Name##InsertFixup(Name *t, uint32_t z)                     \
+{                                                                             \
+    Name##Node *nodes = t->nodes;                                             \
+    /* z is red: only a red parent can break the red-black properties */      \
+    while (nodes[z].parent != BST_NIL                                         \
+           && nodes[nodes[z].parent].color == BST_RED)                        \
+    {                                                                         \
+        uint32_t p = nodes[z].parent;                                         \
+        uint32_t gp = nodes[p].parent;                                        \
+        if (p == nodes[gp].left)                                              \
+        {                                                                     \
+            uint32_t uncle = nodes[gp].right;                                 \
+            if (uncle != BST_NIL && nodes[uncle].color == BST_RED)            \
+            {                                                                 \
+                nodes[p].color = BST_BLACK;                                   \
+                nodes[uncle].color = BST_BLACK;                               \
+                nodes[gp].color = BST_RED;                                    \
+                z = gp;                                                       \
+            }                                                                 \
+            else                                                              \
+            {                                                                 \
+                if (z == nodes[p].right)                                      \
+                {                                                             \
+                    z = p;                                                    \
+                    Name##LeftRotate(t, z);                                   \
+                }                                                             \
+                nodes[nodes[z].parent].color = BST_BLACK;                     \
+                nodes[gp].color = BST_RED;                                    \
+                Name##RightRotate(t, gp);                                     \
+            }                                                                 \
+        }                                                                     \
+        else                                                                  \
+        {                                                                     \
+            uint32_t uncle = nodes[gp].left;                                  \
+            if (uncle != BST_NIL && nodes[uncle].color == BST_RED)            \
+            {                                                                 \
+                nodes[p].color = BST_BLACK;                                   \
+                nodes[uncle].color = BST_BLACK;                               \
+                nodes[gp].color = BST_RED;                                    \
+                z = gp;                                                       \
+            }                                                                 \
+            else                                                              \
+            {                                                                 \
+                if (z == nodes[p].left)                                       \
+                {                                                             \
+                    z = p;                                                    \
+                    Name##RightRotate(t, z);                                  \
+                }                                                             \
+                nodes[nodes[z].parent].color = BST_BLACK;                     \
+                nodes[gp].color = BST_RED;                                    \
+                Name##LeftRotate(t, gp);                                      \
+            }                                                                 \
+        }                                                                     \
+    }                                                                         \
+    nodes[t->root].color = BST_BLACK;                                         \
+}                                                                             \
+static inline bool Name##Insert(Name *t, const Key *key, void *value)         \
+{                                                                             \
+    if (t->size == BST_MAX_ELEMENTS)                                          \
+    {                                                                         \
+        printf(#Name "Insert: too many elements\n");                          \
+        return false;                                                         \
+    }                                                                         \
+    Name##Thaw(t);                                                            \
+    /* the node that may be created is reserved first, so that the array      \
+       of the nodes does not move once the path is followed */                \
+    if (!Name##Reserve(t, 1))                                                 \
+        return false;                                                         \
+    Name##Node *nodes = t->nodes;                                             \
+    uint32_t prev = BST_NIL;                                                  \
+    uint32_t n = t->root;                                                     \
+    int cmp = 0;                                                              \
+    while (n != BST_NIL)                                                      \
+    {                                                                         \
+        cmp = compare(key, &nodes[n].key);                                    \
+        if (cmp == 0)                                                         \
+            break;                                                            \
+        prev = n;                                                             \
+        n = (cmp < 0) ? nodes[n].left : nodes[n].right;                       \
+    }                                                                         \
+    bool created = (n == BST_NIL);                                            \
+    if (!created)                                                             \
+    {                                                                         \
+        /* the key is already present: the element joins its bucket */        \
+        if (!Name##BucketAppend(t, n, key, value))                            \
+            return false;                                                     \
+        nodes[n].size++;                                                      \
+    }                                                                         \
+    else                                                                      \
+    {                                                                         \
+        n = Name##NodeNew(t, key, value);                                     \
+        nodes[n].parent = prev;                                               \
+        if (prev == BST_NIL)                                                  \
+            t->root = n;                                                      \
+        else if (cmp < 0)                                                     \
+            nodes[prev].left = n;                                             \
+        else                                                                  \
+            nodes[prev].right = n;                                            \
+    }                                                                         \
+    /* the new element belongs to every subtree on its path */                \
+    for (uint32_t p = nodes[n].parent; p != BST_NIL; p = nodes[p].parent)     \
+        nodes[p].size++;                                                      \
+    if (created)                                                              \
+    {                                                                         \
+        Name##InsertFixup(t, n);                                              \
+        t->nnodes++;                                                          \
+    }                                                                         \
+    t->size++;                                                                \
+    return true;                                                              \
+}                                                                             \
+static inline void Name##Transplant(Name *t, uint32_t u, uint32_t v)          \
+{                                                                             \
+    Name##Node *nodes = t->nodes;                                             \
+    uint32_t p = nodes[u].parent;                                             \
+    if (p == BST_NIL)                                                         \
+        t->root = v;                                                          \
+    else if (u == nodes[p].left)                                              \
+        nodes[p].left = v;                                                    \
+    else                                                                      \
+        nodes[p].right = v;                                                   \
+    if (v != BST_NIL)                                                         \
+        nodes[v].parent = p;                                                  \
+}                                                                             \
+static inline void Name##RemoveFixup(Name *t, uint32_t x, uint32_t xParent)   \
+{                                                                             \
+    Name##Node *nodes = t->nodes;                                             \
+    /* x carries an extra black: push it up or resolve it with rotations */   \
+    while (x != t->root && (x == BST_NIL || nodes[x].color == BST_BLACK))     \
+    {                                                                         \
+        if (x == nodes[xParent].left)                                         \
+        {                                                                     \
+            uint32_t w = nodes[xParent].right;                                \
+            if (nodes[w].color == BST_RED)                                    \
+            {                                                                 \
+                nodes[w].color = BST_BLACK;                                   \
+                nodes[xParent].color = BST_RED;                               \
+                Name##LeftRotate(t, xParent);                                 \
+                w = nodes[xParent].right;                                     \
+            }                                                                 \
+            if (nodes[nodes[w].left].color == BST_BLACK                       \
+                && nodes[nodes[w].right].color == BST_BLACK)                  \
+            {                                                                 \
+                nodes[w].color = BST_RED;                                     \
+                x = xParent;                                                  \
+                xParent = nodes[x].parent;                                    \
+            }                                                                 \
+            else                                                              \
+            {                                                                 \
+                if (nodes[nodes[w].right].color == BST_BLACK)                 \
+                {                                                             \
+                    nodes[nodes[w].left].color = BST_BLACK;                   \
+                    nodes[w].color = BST_RED;                                 \
+                    Name##RightRotate(t, w);                                  \
+                    w = nodes[xParent].right;                                 \
+                }                                                             \
+                nodes[w].color = nodes[xParent].color;                        \
+                nodes[xParent].color = BST_BLACK;                             \
+                nodes[nodes[w].right].color = BST_BLACK;                      \
+                Name##LeftRotate(t, xParent);                                 \
+                x = t->root;                                                  \
+            }                                                                 \
+        }                                                                     \
+        else                                                                  \
+        {                                                                     \
+            uint32_t w = nodes[xParent].left;                                 \
+            if (nodes[w].color == BST_RED)                                    \
+            {                                                                 \
+                nodes[w].color = BST_BLACK;                                   \
+                nodes[xParent].color = BST_RED;                               \
+                Name##RightRotate(t, xParent);                                \
+                w = nodes[xParent].left;                                      \
+            }                                                                 \
+            if (nodes[nodes[w].right].color == BST_BLACK                      \
+                && nodes[nodes[w].left].color == BST_BLACK)                   \
+            {                                                                 \
+                nodes[w].color = BST_RED;                                     \
+                x = xParent;                                                  \
+                xParent = nodes[x].parent;                                    \
+            }                                                                 \
+            else                                                              \
+            {                                                                 \
+                if (nodes[nodes[w].left].color == BST_BLACK)                  \
+                {                                                             \
+                    nodes[nodes[w].right].color = BST_BLACK;                  \
+                    nodes[w].color = BST_RED;                                 \
+                    Name##LeftRotate(t, w);                                   \
+                    w = nodes[xParent].left;                                  \
+                }                                                             \
+                nodes[w].color = nodes[xParent].color;                        \
+                nodes[xParent].color = BST_BLACK;                             \
+                nodes[nodes[w].left].color = BST_BLACK;                       \
+                Name##RightRotate(t, xParent);                                \
+                x = t->root;                                                  \
+            }                                                                 \
+        }                                                                     \
+    }                                                                         \
+    nodes[x].color = BST_BLACK;                                               \
+}                                                                             \
+static inline bool Name##Remove(Name *t, const Key *key, void *value)         \
+{                                                                             \
+    Name##Node *nodes = t->nodes;                                             \
+    uint32_t z = t->root;                                                     \
+    while (z != BST_NIL)                                                      \
+    {                                                                         \
+        int cmp = compare(key, &nodes[z].key);                                \
+        if (cmp == 0)                                                         \
+            break;                                                            \
+        z = (cmp < 0) ? nodes[z].left : nodes[z].right;                       \
+    }                                                                         \
+    if (z == BST_NIL)                                                         \
+        return false;                                                         \
+    /* the element is one of those of the node with that key */               \
+    Name##Node *zn = &nodes[z];                                               \
+    size_t count = Name##Count(t, z);                                         \
+    size_t i = 0;                                                             \
+    for (; i < count; i++)                                                    \
+    {                                                                         \
+        const Key *k;                                                         \
+        void *v;                                                              \
+        Name##Element(t, z, i, &k, &v);                                       \
+        if (v == value)                                                       \
+            break;                                                            \
+    }                                                                         \
+    if (i == count)                                                           \
+        return false;                                                         \
+    Name##Thaw(t);                                                            \
+    if (count > 1)                                                            \
+    {                                                                         \
+        /* the last element of the bucket takes the place of the removed      \
+           one, the node stays in the tree */                                 \
+        Name##Bucket *dups = t->dups[z];                                      \
+        Name##Entry last = dups->entries[--dups->size];                       \
+        if (i == 0)                                                           \
+        {                                                                     \
+            zn->key = last.key;                                               \
+            zn->value = last.value;                                           \
+        }                                                                     \
+        else                                                                  \
+        {                                                                     \
+            dups->entries[i - 1] = last;                                      \
+        }                                                                     \
+        if (dups->size == 0)                                                  \
+        {                                                                     \
+            free(dups);                                                       \
+            t->dups[z] = NULL;                                                \
+        }                                                                     \
+        for (uint32_t p = z; p != BST_NIL; p = nodes[p].parent)               \
+            nodes[p].size--;                                                  \
+        t->size--;                                                            \
+        return true;                                                          \
+    }                                                                         \
+    /* y is the node that is actually unlinked from its place: z itself, or   \
+       its successor which then takes the place of z */                       \
+    uint32_t y = z;                                                           \
+    unsigned int removedColor = zn->color;                                    \
+    uint32_t x, xParent;                                                      \
+    if (zn->left == BST_NIL)                                                  \
+    {                                                                         \
+        x = zn->right;                                                        \
+        xParent = zn->parent;                                                 \
+        Name##Transplant(t, z, zn->right);                                    \
+    }                                                                         \
+    else if (zn->right == BST_NIL)                                            \
+    {                                                                         \
+        x = zn->left;                                                         \
+        xParent = zn->parent;                                                 \
+        Name##Transplant(t, z, zn->left);                                     \
+    }                                                                         \
+    else                                                                      \
+    {                                                                         \
+        y = zn->right;                                                        \
+        while (nodes[y].left != BST_NIL)                                      \
+            y = nodes[y].left;                                                \
+        removedColor = nodes[y].color;                                        \
+        x = nodes[y].right;                                                   \
+        if (nodes[y].parent == z)                                             \
+        {                                                                     \
+            xParent = y;                                                      \
+        }                                                                     \
+        else                                                                  \
+        {                                                                     \
+            xParent = nodes[y].parent;                                        \
+            Name##Transplant(t, y, nodes[y].right);                           \
+            nodes[y].right = zn->right;                                       \
+            nodes[nodes[y].right].parent = y;                                 \
+        }                                                                     \
+        Name##Transplant(t, z, y);                                            \
+        nodes[y].left = zn->left;                                             \
+        nodes[nodes[y].left].parent = y;                                      \
+        nodes[y].color = zn->color;                                           \
+    }                                                                         \
+    /* the sizes must be exact before the rotations of the fixup */           \
+    for (uint32_t p = xParent; p != BST_NIL; p = nodes[p].parent)             \
+        nodes[p].size = (uint32_t)(Name##Count(t, p)                          \
+                                   + Name##NodeSize(t, nodes[p].left)         \
+                                   + Name##NodeSize(t, nodes[p].right));      \
+    if (removedColor == BST_BLACK)                                            \
+        Name##RemoveFixup(t, x, xParent);                                     \
+    Name##NodeRelease(t, z);                                                  \
+    t->size--;                                                                \
+    t->nnodes--;                                                              \
+    return true;                                                              \
+}                                                                             \
+static inline void *Name##Search(Name *t, const Key *key)                     \
+{                                                                             \
+    if (t->frozenKeys != NULL)                                                \
+    {                                                                         \
+        size_t k = Name##FrozenLowerBound(t, key);                            \
+        if (k != 0 && compare(&t->frozenKeys[k], key) == 0)                   \
+            return t->frozenValues[k];                                        \
+        return NULL;                                                          \
+    }                                                                         \
+    Name##Node *nodes = t->nodes;                                             \
+    uint32_t n = t->root;                                                     \
+    while (n != BST_NIL)                                                      \
+    {                                                                         \
+        int cmp = compare(key, &nodes[n].key);                                \
+        if (cmp == 0)                                                         \
+            return nodes[n].value;                                            \
+        n = (cmp < 0) ? nodes[n].left : nodes[n].right;                       \
+    }                                                                         \
+    return NULL;                                                              \
+}                                                                             \
+static inline void Name##SearchBatchRec(Name *t, uint32_t n,                  \
+                                        Name##Entry *queries, size_t m)       \
+{                                                                             \
+    /* the queries that are not found keep their NULL result */               \
+    while (n != BST_NIL && m > 0)                                             \
+    {                                                                         \
+        Name##Node *node = &t->nodes[n];                                      \
+        /* [lo, hi[ is the range of the queries equal to the key of n */      \
+        size_t lo = 0, hi = m;                                                \
+        while (lo < hi)                                                       \
+        {                                                                     \
+            size_t mid = lo + (hi - lo) / 2;                                  \
+            if (compare(&queries[mid].key, &node->key) < 0)                   \
+                lo = mid + 1;                                                 \
+            else                                                              \
+                hi = mid;                                                     \
+        }                                                                     \
+        hi = lo;                                                              \
+        while (hi < m && compare(&queries[hi].key, &node->key) == 0)          \
+        {                                                                     \
+            *(void **)queries[hi].value = node->value;                        \
+            hi++;                                                             \
+        }                                                                     \
+        /* the smaller keys go left, and the loop follows the greater         \
+           ones */                                                            \
+        Name##SearchBatchRec(t, node->left, queries, lo);                     \
+        queries += hi;                                                        \
+        m -= hi;                                                              \
+        n = node->right;                                                      \
+    }                                                                         \
+}                                                                             \
+static inline void Name##FrozenSearchRec(Name *t, size_t k,                   \
+                                         Name##Entry *queries, size_t m)      \
+{                                                                             \
+    /* the queries all reach slot k: they are split once per slot, with a     \
+       binary search */                                                       \
+    size_t n = t->size;                                                       \
+    while (k <= n && m > 0)                                                   \
+    {                                                                         \
+        size_t lo = 0, hi = m;                                                \
+        while (lo < hi)                                                       \
+        {                                                                     \
+            size_t mid = lo + (hi - lo) / 2;                                  \
+            if (compare(&t->frozenKeys[k], &queries[mid].key) < 0)            \
+                hi = mid;                                                     \
+            else                                                              \
+                lo = mid + 1;                                                 \
+        }                                                                     \
+        Name##FrozenSearchRec(t, 2 * k, queries, lo);                         \
+        queries += lo;                                                        \
+        m -= lo;                                                              \
+        k = 2 * k + 1;                                                        \
+    }                                                                         \
+    /* the group left the array at the same place: its keys share their       \
+       lower bound */                                                         \
+    size_t bound = eytzingerLowerBound(k);                                    \
+    for (size_t i = 0; bound != 0 && i < m; i++)                              \
+    {                                                                         \
+        if (compare(&t->frozenKeys[bound], &queries[i].key) == 0)             \
+            *(void **)queries[i].value = t->frozenValues[bound];              \
+    }                                                                         \
+}                                                                             \
+static inline bool Name##SearchBatch(Name *t, const Key *keys, size_t n,      \
+                                     void **values)                           \
+{                                                                             \
+    Name##Entry *queries = malloc(2 * n * sizeof(Name##Entry));               \
+    if (n > 0 && queries == NULL)                                             \
+    {                                                                         \
+        printf(#Name "SearchBatch: allocation error\n");                      \
+        return false;                                                         \
+    }                                                                         \
+    for (size_t i = 0; i < n; i++)                                            \
+    {                                                                         \
+        values[i] = NULL;                                                     \
+        queries[i].key = keys[i];                                             \
+        queries[i].value = &values[i];                                        \
+    }                                                                         \
+    Name##Sort(queries, queries + n, n);                                      \
+    if (t->frozenKeys != NULL)                                                \
+        Name##FrozenSearchRec(t, 1, queries, n);                              \
+    else                                                                      \
+        Name##SearchBatchRec(t, t->root, queries, n);                         \
+    free(queries);                                                            \
+    return true;                                                              \
+}                                                                             \
+static inline void Name##FrozenSearchInterleaved(Name *t, const Key *keys,    \
+                                                 size_t n, void **values)     \
+{                                                                             \
+    /* the descents have the same length (within one level): the groups       \
+       go down in lockstep, the slots of a level being prefetched for all     \
+       the searches before the first comparison needs one */                  \
+    size_t slots = t->size;                                                   \
+    for (size_t base = 0; base < n; base += BST_LANES)                        \
+    {                                                                         \
+        size_t m = (n - base < BST_LANES) ? n - base : BST_LANES;             \
+        size_t slot[BST_LANES];                                               \
+        for (size_t i = 0; i < m; i++)                                        \
+            slot[i] = 1;                                                      \
+        for (bool active = slots > 0; active;)                                \
+        {                                                                     \
+            active = false;                                                   \
+            for (size_t i = 0; i < m; i++)                                    \
+            {                                                                 \
+                if (slot[i] <= slots)                                         \
+                    BST_PREFETCH(&t->frozenKeys[slot[i]]);                    \
+            }                                                                 \
+            for (size_t i = 0; i < m; i++)                                    \
+            {                                                                 \
+                if (slot[i] <= slots)                                         \
+                {                                                             \
+                    int cmp = compare(&t->frozenKeys[slot[i]],                \
+                                      &keys[base + i]);                       \
+                    slot[i] = 2 * slot[i] + (cmp < 0);                        \
+                    active = true;                                            \
+                }                                                             \
+            }                                                                 \
+        }                                                                     \
+        for (size_t i = 0; i < m; i++)                                        \
+        {                                                                     \
+            size_t k = eytzingerLowerBound(slot[i]);                          \
+            values[base + i] = NULL;                                          \
+            if (k != 0 && compare(&t->frozenKeys[k], &keys[base + i]) == 0)   \
+                values[base + i] = t->frozenValues[k];                        \
+        }                                                                     \
+    }                                                                         \
+}                                                                             \
+static inline void Name##SearchInterleaved(Name *t, const Key *keys,          \
+                                           size_t n, void **values)           \
+{                                                                             \
+    if (t->frozenKeys != NULL)                                                \
+    {                                                                         \
+        Name##FrozenSearchInterleaved(t, keys, n, values);                    \
+        return;                                                               \
+    }                                                                         \
+    uint32_t nodes[BST_LANES]; /* node to compare to in each lane */          \
+    size_t queries[BST_LANES]; /* index of the query of each lane */          \
+    size_t nlanes = 0, next = 0;                                              \
+    for (size_t i = 0; i < n; i++)                                            \
+        values[i] = NULL;                                                     \
+    if (t->root == BST_NIL)                                                   \
+        return;                                                               \
+    for (; nlanes < BST_LANES && next < n; nlanes++)                          \
+    {                                                                         \
+        queries[nlanes] = next++;                                             \
+        nodes[nlanes] = t->root;                                              \
+    }                                                                         \
+    while (nlanes > 0)                                                        \
+    {                                                                         \
+        /* each lane compares to the node it prefetched at the previous       \
+           step, while the other lanes wait for theirs */                     \
+        size_t i = 0;                                                         \
+        while (i < nlanes)                                                    \
+        {                                                                     \
+            Name##Node *node = &t->nodes[nodes[i]];                           \
+            uint32_t child = BST_NIL;                                         \
+            int cmp = compare(&keys[queries[i]], &node->key);                 \
+            if (cmp == 0)                                                     \
+                values[queries[i]] = node->value;                             \
+            else                                                              \
+                child = (cmp < 0) ? node->left : node->right;                 \
+            if (child == BST_NIL)                                             \
+            {                                                                 \
+                /* the search of the lane is over: it starts the next         \
+                   query, or the last lane takes its place */                 \
+                if (next == n)                                                \
+                {                                                             \
+                    nlanes--;                                                 \
+                    queries[i] = queries[nlanes];                             \
+                    nodes[i] = nodes[nlanes];                                 \
+                    continue;                                                 \
+                }                                                             \
+                queries[i] = next++;                                          \
+                child = t->root;                                              \
+            }                                                                 \
+            nodes[i] = child;                                                 \
+            BST_PREFETCH(&t->nodes[child]);                                   \
+            i++;                                                              \
+        }                                                                     \
+    }                                                                         \
+}                                                                             \
+static inline uint32_t Name##Successor(Name *t, uint32_t n)                   \
+{                                                                             \
+    Name##Node *nodes = t->nodes;                                             \
+    if (nodes[n].right != BST_NIL)                                            \
+    {                                                                         \
+        n = nodes[n].right;                                                   \
+        while (nodes[n].left != BST_NIL)                                      \
+            n = nodes[n].left;                                                \
+        return n;                                                             \
+    }                                                                         \
+    while (nodes[n].parent != BST_NIL && n == nodes[nodes[n].parent].right)   \
+        n = nodes[n].parent;                                                  \
+    return nodes[n].parent;                                                   \
+}                                                                             \
+static inline bool Name##Freeze(Name *t)                                      \
+{                                                                             \
+    Name##Thaw(t);                                                            \
+    size_t n = t->size;                                                       \
+    Key *keys = malloc((n + 1) * sizeof(Key));                                \
+    void **values = malloc((n + 1) * sizeof(void *));                         \
+    if (keys == NULL || values == NULL)                                       \
+    {                                                                         \
+        printf(#Name "Freeze: allocation error\n");                           \
+        free(keys);                                                           \
+        free(values);                                                         \
+        return false;                                                         \
+    }                                                                         \
+    /* the in-order walks of the tree and of the array go together */         \
+    uint32_t node = t->root;                                                  \
+    while (node != BST_NIL && t->nodes[node].left != BST_NIL)                 \
+        node = t->nodes[node].left;                                           \
+    size_t index = 0;                                                         \
+    for (size_t k = eytzingerFirst(n); k != 0; k = eytzingerNext(k, n))       \
+    {                                                                         \
+        if (index == Name##Count(t, node))                                    \
+        {                                                                     \
+            node = Name##Successor(t, node);                                  \
+            index = 0;                                                        \
+        }                                                                     \
+        const Key *key;                                                       \
+        Name##Element(t, node, index++, &key, &values[k]);                    \
+        keys[k] = *key;                                                       \
+    }                                                                         \
+    t->frozenKeys = keys;                                                     \
+    t->frozenValues = values;                                                 \
+    return true;                                                              \
+}                                                                             \
+static inline bool Name##RangeVisit(Name *t, const Key *keyMin,               \
+                                    const Key *keyMax,                        \
+                                    bool visit(const Key *, void *, void *),  \
+                                    void *ctx)                                \
+{                                                                             \
+    if (compare(keyMin, keyMax) > 0)                                          \
+        return true;                                                          \
+    if (t->frozenKeys != NULL)                                                \
+    {                                                                         \
+        for (size_t k = Name##FrozenLowerBound(t, keyMin);                    \
+             k != 0 && compare(&t->frozenKeys[k], keyMax) <= 0;               \
+             k = eytzingerNext(k, t->size))                                   \
+        {                                                                     \
+            if (!visit(&t->frozenKeys[k], t->frozenValues[k], ctx))           \
+                return false;                                                 \
+        }                                                                     \
+        return true;                                                          \
+    }                                                                         \
+    /* the first node whose key is >= keyMin */                               \
+    uint32_t first = BST_NIL;                                                 \
+    for (uint32_t n = t->root; n != BST_NIL;)                                 \
+    {                                                                         \
+        if (compare(&t->nodes[n].key, keyMin) >= 0)                           \
+        {                                                                     \
+            first = n;                                                        \
+            n = t->nodes[n].left;                                             \
+        }                                                                     \
+        else                                                                  \
+        {                                                                     \
+            n = t->nodes[n].right;                                            \
+        }                                                                     \
+    }                                                                         \
+    /* the keys are checked once per node, the duplicates of a key being      \
+       all in the bucket of its node */                                       \
+    for (uint32_t n = first;                                                  \
+         n != BST_NIL && compare(&t->nodes[n].key, keyMax) <= 0;              \
+         n = Name##Successor(t, n))                                           \
+    {                                                                         \
+        size_t count = Name##Count(t, n);                                     \
+        for (size_t i = 0; i < count; i++)                                    \
+        {                                                                     \
+            const Key *key;                                                   \
+            void *value;                                                      \
+            Name##Element(t, n, i, &key, &value);                             \
+            if (!visit(key, value, ctx))                                      \
+                return false;                                                 \
+        }                                                                     \
+    }                                                                         \
+    return true;                                                              \
+}                                                                             \
+static inline size_t Name##CountBelow(Name *t, const Key *key, bool orEqual)  \
+{                                                                             \
+    size_t count = 0;                                                         \
+    uint32_t i = t->root;                                                     \
+    while (i != BST_NIL)                                                      \
+    {                                                                         \
+        Name##Node *n = &t->nodes[i];                                         \
+        int cmp = compare(&n->key, key);                                      \
+        if (cmp < 0 || (orEqual && cmp == 0))                                 \
+        {                                                                     \
+            /* n and its whole left subtree are below key */                  \
+            count += Name##NodeSize(t, n->left) + Name##Count(t, i);          \
+            i = n->right;                                                     \
+        }                                                                     \
+        else                                                                  \
+        {                                                                     \
+            i = n->left;                                                      \
+        }                                                                     \
+    }                                                                         \
+    return count;                                                             \
+}                                                                             \
+static inline size_t Name##RangeCount(Name *t, const Key *keyMin,             \
+                                      const Key *keyMax)                      \
+{                                                                             \
+    if (t->root == BST_NIL || compare(keyMin, keyMax) > 0)                    \
+        return 0;                                                             \
+    return Name##CountBelow(t, keyMax, true)                                  \
+           - Name##CountBelow(t, keyMin, false);                              \
+}                                                                             \
+static inline bool Name##Visit(Name *t,                                       \
+                               bool visit(const Key *, void *, void *),       \
+                               void *ctx)                                     \
+{                                                                             \
+    /* the array of the nodes is scanned sequentially, skipping the NIL       \
+       node and the released ones (of size 0) */                              \
+    for (uint32_t n = 1; n < t->used; n++)                                    \
+    {                                                                         \
+        if (t->nodes[n].size == 0)                                            \
+            continue;                                                         \
+        size_t count = Name##Count(t, n);                                     \
+        for (size_t i = 0; i < count; i++)                                    \
+        {                                                                     \
+            const Key *key;                                                   \
+            void *value;                                                      \
+            Name##Element(t, n, i, &key, &value);                             \
+            if (!visit(key, value, ctx))                                      \
+                return false;                                                 \
+        }                                                                     \
+    }                                                                         \
+    return true;                                                              \
+}
+
+#endif // !_BSTTEMPLATE_H_
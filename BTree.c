@@ -0,0 +1,524 @@
+/* ========================================================================= *
+ * BTree definition
+ * ========================================================================= */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <stdint.h>
+
+#include "BTree.h"
+#include "Point.h"
+#include "List.h"
+#include "Heap.h"
+
+// Size of a cache line: the nodes are padded to a multiple of it, and
+// allocated on such a boundary
+#define CACHE_LINE 64
+
+// Number of positions stored in a leaf: its x[] and y[] arrays fill 4 cache
+// lines each.
+#define BT_LEAF_SIZE 32
+
+// Number of separators of an inner node (which has one more child): its x[]
+// and y[] arrays fill 2 cache lines each.
+#define BT_INNER_SIZE 16
+
+/* Opaque Structure */
+
+typedef struct BTLeaf_t BTLeaf;
+
+struct BTLeaf_t
+{
+    // positions sorted by x, then by y, and their values
+    double x[BT_LEAF_SIZE];
+    double y[BT_LEAF_SIZE];
+    void *values[BT_LEAF_SIZE];
+    size_t size;
+    BTLeaf *prev;
+    BTLeaf *next;
+    // the leaves of an array start on cache lines, as their x[] and y[]
+    char padding[CACHE_LINE - (BT_LEAF_SIZE * sizeof(void *) + sizeof(size_t)
+                               + 2 * sizeof(BTLeaf *)) % CACHE_LINE];
+};
+
+typedef struct BTInner_t BTInner;
+
+struct BTInner_t
+{
+    // separator i is the smallest position of the subtree of child i + 1:
+    // the positions of child i are lower than or equal to it
+    double x[BT_INNER_SIZE];
+    double y[BT_INNER_SIZE];
+    void *children[BT_INNER_SIZE + 1]; // leaves on the lowest inner level
+    size_t size; // number of separators
+    char padding[CACHE_LINE - ((BT_INNER_SIZE + 1) * sizeof(void *)
+                               + sizeof(size_t)) % CACHE_LINE];
+};
+
+struct BTree_t
+{
+    void *root; // a leaf if height = 0, an inner node otherwise
+    size_t height; // number of levels of inner nodes
+    size_t size;
+    // the nodes of each kind share a single allocation, level by level,
+    // aligned on a cache line within the block that is freed
+    BTLeaf *leaves;
+    size_t nleaves;
+    BTInner *inners;
+    void *leavesBlock;
+    void *innersBlock;
+};
+
+typedef struct Entry_t Entry;
+
+struct Entry_t
+{
+    double x;
+    double y;
+    void *value;
+};
+
+/* Prototypes of static functions */
+
+/* ------------------------------------------------------------------------- *
+ * Compares two entries by x, then by y (comparison function of qsort).
+ *
+ * PARAMETERS
+ * a, b         Two valid pointers to Entry objects.
+ *
+ * RETURN
+ * res          A negative, zero or positive value if a is lower than, equal
+ *              to or greater than b.
+ * ------------------------------------------------------------------------- */
+static int entryCompare(const void *a, const void *b);
+
+/* ------------------------------------------------------------------------- *
+ * Allocates memory starting on a cache line. malloc() only guarantees the
+ * alignment of the basic types, so a larger block is taken, and the
+ * pointer to free is returned separately.
+ *
+ * PARAMETERS
+ * size         The number of bytes to allocate.
+ * block        Set to the pointer to pass to free(), or NULL in case of
+ *              allocation error.
+ *
+ * RETURN
+ * ptr          A pointer to size bytes aligned on CACHE_LINE, or NULL in
+ *              case of allocation error.
+ * ------------------------------------------------------------------------- */
+static void *cacheAlignedMalloc(size_t size, void **block);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the first position of the BTree that is greater than or equal to
+ * (x, y) in the order of ptCompare.
+ *
+ * PARAMETERS
+ * bt           A valid pointer to a BTree object.
+ * x, y         The coordinates of the position.
+ * index        Set to the index of the position in its leaf.
+ *
+ * RETURN
+ * leaf         The leaf holding the position, or NULL if all the positions
+ *              are lower than (x, y).
+ * ------------------------------------------------------------------------- */
+static BTLeaf *btLowerBound(BTree *bt, double x, double y, size_t *index);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the first position of the BTree that may lie in a ball, from the
+ * lowest x coordinate of the ball. This bound is lowered by a few ulps: the
+ * positions are tested with the rounded squared distance, which accepts a
+ * point at a distance of exactly r whose x is rounded below qx - r.
+ *
+ * PARAMETERS
+ * bt           A valid pointer to a BTree object.
+ * qx           The x coordinate of the center of the ball.
+ * r            The radius of the ball.
+ * index        Set to the index of the position in its leaf.
+ *
+ * RETURN
+ * leaf         The leaf holding the position, or NULL if there is none.
+ * ------------------------------------------------------------------------- */
+static BTLeaf *btBallStart(BTree *bt, double qx, double r, size_t *index);
+
+/* ------------------------------------------------------------------------- *
+ * Inserts a value at the end of a list (callback of btBallVisit used by
+ * btBallSearch).
+ *
+ * PARAMETERS
+ * value        The value to insert.
+ * l            A valid pointer to a list object.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool collect(void *value, void *l);
+
+/* Function definitions */
+
+int entryCompare(const void *a, const void *b)
+{
+    const Entry *ea = a, *eb = b;
+    if (ea->x != eb->x)
+        return (ea->x < eb->x) ? -1 : 1;
+    if (ea->y != eb->y)
+        return (ea->y < eb->y) ? -1 : 1;
+    return 0;
+}
+
+void *cacheAlignedMalloc(size_t size, void **block)
+{
+    *block = malloc(size + CACHE_LINE - 1);
+    if (*block == NULL)
+        return NULL;
+    uintptr_t address = (uintptr_t)*block;
+    return (char *)*block + (CACHE_LINE - address % CACHE_LINE) % CACHE_LINE;
+}
+
+BTree *btBuildFromArrays(Point **points, void **values, size_t n)
+{
+    BTree *bt = malloc(sizeof(BTree));
+    if (bt == NULL)
+    {
+        printf("btBuildFromArrays: allocation error\n");
+        return NULL;
+    }
+    bt->root = NULL;
+    bt->height = 0;
+    bt->size = n;
+    bt->leaves = NULL;
+    bt->nleaves = 0;
+    bt->inners = NULL;
+    bt->leavesBlock = NULL;
+    bt->innersBlock = NULL;
+    if (n == 0)
+        return bt;
+
+    // number of inner nodes of all the levels above the leaves
+    size_t nleaves = (n + BT_LEAF_SIZE - 1) / BT_LEAF_SIZE;
+    size_t ninners = 0;
+    for (size_t c = nleaves; c > 1; bt->height++)
+    {
+        c = (c + BT_INNER_SIZE) / (BT_INNER_SIZE + 1);
+        ninners += c;
+    }
+
+    Entry *entries = malloc(n * sizeof(Entry));
+    // smallest position of each node of the level being linked
+    double *xmin = malloc(nleaves * sizeof(double));
+    double *ymin = malloc(nleaves * sizeof(double));
+    bt->leaves = cacheAlignedMalloc(nleaves * sizeof(BTLeaf), &bt->leavesBlock);
+    if (ninners > 0)
+        bt->inners = cacheAlignedMalloc(ninners * sizeof(BTInner), &bt->innersBlock);
+    if (entries == NULL || xmin == NULL || ymin == NULL || bt->leaves == NULL
+        || (ninners > 0 && bt->inners == NULL))
+    {
+        printf("btBuildFromArrays: allocation error\n");
+        free(entries);
+        free(xmin);
+        free(ymin);
+        btFree(bt, false);
+        return NULL;
+    }
+    bt->nleaves = nleaves;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        entries[i].x = ptGetx(points[i]);
+        entries[i].y = ptGety(points[i]);
+        entries[i].value = values[i];
+    }
+    qsort(entries, n, sizeof(Entry), entryCompare);
+
+    // full leaves, the last one taking the remaining positions
+    for (size_t l = 0; l < nleaves; l++)
+    {
+        BTLeaf *leaf = &bt->leaves[l];
+        size_t first = l * BT_LEAF_SIZE;
+        leaf->size = (n - first < BT_LEAF_SIZE) ? n - first : BT_LEAF_SIZE;
+        for (size_t i = 0; i < leaf->size; i++)
+        {
+            leaf->x[i] = entries[first + i].x;
+            leaf->y[i] = entries[first + i].y;
+            leaf->values[i] = entries[first + i].value;
+        }
+        leaf->prev = (l > 0) ? &bt->leaves[l - 1] : NULL;
+        leaf->next = (l + 1 < nleaves) ? &bt->leaves[l + 1] : NULL;
+        xmin[l] = leaf->x[0];
+        ymin[l] = leaf->y[0];
+    }
+    free(entries);
+
+    // the inner levels, bottom-up: each node takes the next children of
+    // the level below, and the smallest position of a node is the one of
+    // its first child (so xmin and ymin can be overwritten in place)
+    size_t count = nleaves; // number of nodes of the level below
+    size_t below = 0; // index in bt->inners of the first of them
+    size_t next = 0; // index in bt->inners of the first node of the level
+    for (size_t h = 0; h < bt->height; h++)
+    {
+        size_t nparents = (count + BT_INNER_SIZE) / (BT_INNER_SIZE + 1);
+        for (size_t p = 0; p < nparents; p++)
+        {
+            BTInner *inner = &bt->inners[next + p];
+            size_t first = p * (BT_INNER_SIZE + 1);
+            size_t last = (first + BT_INNER_SIZE + 1 < count) ? first + BT_INNER_SIZE + 1 : count;
+            inner->size = last - first - 1;
+            for (size_t c = first; c < last; c++)
+            {
+                if (h == 0)
+                    inner->children[c - first] = &bt->leaves[c];
+                else
+                    inner->children[c - first] = &bt->inners[below + c];
+                if (c > first)
+                {
+                    inner->x[c - first - 1] = xmin[c];
+                    inner->y[c - first - 1] = ymin[c];
+                }
+            }
+            xmin[p] = xmin[first];
+            ymin[p] = ymin[first];
+        }
+        below = next;
+        next += nparents;
+        count = nparents;
+    }
+    free(xmin);
+    free(ymin);
+
+    bt->root = (bt->height == 0) ? (void *)bt->leaves : (void *)&bt->inners[ninners - 1];
+    return bt;
+}
+
+void btFree(BTree *bt, bool freeValue)
+{
+    if (freeValue)
+    {
+        for (size_t l = 0; l < bt->nleaves; l++)
+        {
+            for (size_t i = 0; i < bt->leaves[l].size; i++)
+                free(bt->leaves[l].values[i]);
+        }
+    }
+    free(bt->leavesBlock);
+    free(bt->innersBlock);
+    free(bt);
+}
+
+size_t btSize(BTree *bt)
+{
+    return bt->size;
+}
+
+BTLeaf *btLowerBound(BTree *bt, double x, double y, size_t *index)
+{
+    if (bt->root == NULL)
+        return NULL;
+
+    // the separators (and the positions of a leaf) are sorted: counting
+    // those lower than (x, y) gives the child (or the index) to follow,
+    // without a branch depending on the coordinates
+    void *node = bt->root;
+    for (size_t h = 0; h < bt->height; h++)
+    {
+        BTInner *inner = node;
+        size_t c = 0;
+        for (size_t i = 0; i < inner->size; i++)
+            c += (inner->x[i] < x) | ((inner->x[i] == x) & (inner->y[i] < y));
+        node = inner->children[c];
+    }
+    BTLeaf *leaf = node;
+    size_t c = 0;
+    for (size_t i = 0; i < leaf->size; i++)
+        c += (leaf->x[i] < x) | ((leaf->x[i] == x) & (leaf->y[i] < y));
+
+    // the position may be the first one of a following leaf (the leaves
+    // emptied by removals are skipped)
+    while (leaf != NULL && c == leaf->size)
+    {
+        leaf = leaf->next;
+        c = 0;
+    }
+    *index = c;
+    return leaf;
+}
+
+void *btSearch(BTree *bt, Point *q)
+{
+    double x = ptGetx(q), y = ptGety(q);
+    size_t i;
+    BTLeaf *leaf = btLowerBound(bt, x, y, &i);
+    if (leaf == NULL || leaf->x[i] != x || leaf->y[i] != y)
+        return NULL;
+    return leaf->values[i];
+}
+
+bool btRemove(BTree *bt, Point *q, void *value)
+{
+    double x = ptGetx(q), y = ptGety(q);
+    size_t i;
+    BTLeaf *leaf = btLowerBound(bt, x, y, &i);
+
+    // the duplicates of q follow each other, possibly across leaves
+    for (; leaf != NULL; leaf = leaf->next, i = 0)
+    {
+        for (; i < leaf->size; i++)
+        {
+            if (leaf->x[i] != x || leaf->y[i] != y)
+                return false;
+            if (leaf->values[i] != value)
+                continue;
+
+            // the following positions are shifted to keep the leaf sorted
+            size_t after = leaf->size - i - 1;
+            memmove(&leaf->x[i], &leaf->x[i + 1], after * sizeof(double));
+            memmove(&leaf->y[i], &leaf->y[i + 1], after * sizeof(double));
+            memmove(&leaf->values[i], &leaf->values[i + 1], after * sizeof(void *));
+            leaf->size--;
+            bt->size--;
+            return true;
+        }
+    }
+    return false;
+}
+
+BTLeaf *btBallStart(BTree *bt, double qx, double r, size_t *index)
+{
+    double xmin = (qx - r) - 4 * DBL_EPSILON * (fabs(qx) + r);
+    return btLowerBound(bt, xmin, -INFINITY, index);
+}
+
+bool collect(void *value, void *l)
+{
+    return listInsertLast(l, value);
+}
+
+List *btBallSearch(BTree *bt, Point *q, double r)
+{
+    List *list = listNew();
+    if (list == NULL)
+        return NULL;
+    if (!btBallVisit(bt, q, r, collect, list))
+    {
+        listFree(list, false);
+        return NULL;
+    }
+    return list;
+}
+
+bool btBallVisit(BTree *bt, Point *q, double r,
+                 bool visit(void *value, void *ctx), void *ctx)
+{
+    double qx = ptGetx(q), qy = ptGety(q);
+    double r2 = r * r;
+    size_t i;
+    BTLeaf *leaf = btBallStart(bt, qx, r, &i);
+    for (; leaf != NULL; leaf = leaf->next, i = 0)
+    {
+        for (; i < leaf->size; i++)
+        {
+            // the scan stops with the same rounded test as the positions,
+            // rather than on a rounded qx + r
+            double dx = leaf->x[i] - qx;
+            if (dx > 0 && dx * dx > r2)
+                return true;
+            double dy = leaf->y[i] - qy;
+            if (dx * dx + dy * dy <= r2 && !visit(leaf->values[i], ctx))
+                return false;
+        }
+    }
+    return true;
+}
+
+size_t btBallCount(BTree *bt, Point *q, double r)
+{
+    double qx = ptGetx(q), qy = ptGety(q);
+    double r2 = r * r;
+    size_t count = 0;
+    size_t i;
+    BTLeaf *leaf = btBallStart(bt, qx, r, &i);
+    for (; leaf != NULL; leaf = leaf->next, i = 0)
+    {
+        for (; i < leaf->size; i++)
+        {
+            double dx = leaf->x[i] - qx;
+            if (dx > 0 && dx * dx > r2)
+                return count;
+            double dy = leaf->y[i] - qy;
+            count += (dx * dx + dy * dy <= r2);
+        }
+    }
+    return count;
+}
+
+List *btKNearest(BTree *bt, Point *q, size_t k)
+{
+    // no more than the stored positions can be returned: the heap is sized
+    // for them, whatever k is
+    if (k > bt->size)
+        k = bt->size;
+    Heap *heap = heapNew(k);
+    if (heap == NULL)
+        return NULL;
+
+    double qx = ptGetx(q), qy = ptGety(q);
+    bool error = false;
+
+    // two scans start at q: forward from position i of the leaf upper, and
+    // backward from position before - 1 of the leaf lower
+    size_t i = 0, before = 0;
+    BTLeaf *upper = NULL, *lower = NULL;
+    if (k > 0 && bt->root != NULL)
+    {
+        upper = btLowerBound(bt, qx, qy, &i);
+        // if all the positions are lower than q, only the backward scan
+        // remains, from the end
+        lower = (upper != NULL) ? upper : &bt->leaves[bt->nleaves - 1];
+        before = (upper != NULL) ? i : lower->size;
+    }
+
+    while (!error)
+    {
+        while (lower != NULL && before == 0)
+        {
+            lower = lower->prev;
+            before = (lower != NULL) ? lower->size : 0;
+        }
+        while (upper != NULL && i == upper->size)
+        {
+            upper = upper->next;
+            i = 0;
+        }
+        double dxUp = (upper != NULL) ? upper->x[i] - qx : INFINITY;
+        double dxLow = (lower != NULL) ? qx - lower->x[before - 1] : INFINITY;
+
+        // the gap in x of each scan only grows: it stops once this gap
+        // alone exceeds the k-th best distance
+        bool up = (dxUp <= dxLow);
+        double dx = up ? dxUp : dxLow;
+        if (dx == INFINITY || (heapSize(heap) == k && dx * dx > heapMaxPriority(heap)))
+            break;
+
+        double dy;
+        void *value;
+        if (up)
+        {
+            dy = upper->y[i] - qy;
+            value = upper->values[i++];
+        }
+        else
+        {
+            before--;
+            dy = lower->y[before] - qy;
+            value = lower->values[before];
+        }
+        error = !heapOfferBounded(heap, k, dx * dx + dy * dy, value);
+    }
+
+    List *list = error ? NULL : heapToSortedList(heap);
+    heapFree(heap);
+    return list;
+}
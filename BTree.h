@@ -0,0 +1,177 @@
+/* ========================================================================= *
+ * BTree interface:
+ * A B+-tree of positions in the order of ptCompare (by x, then by y). The
+ * coordinates are stored inline in the nodes, whose arrays fill whole cache
+ * lines, so that a search reads a few wide nodes instead of one node per
+ * level of a binary tree. The leaves are linked in both directions, and
+ * range scans walk them sequentially.
+ * ========================================================================= */
+
+#ifndef _BTREE_H_
+#define _BTREE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "Point.h"
+#include "List.h"
+
+/* Opaque Structure */
+typedef struct BTree_t BTree;
+
+/* ------------------------------------------------------------------------- *
+ * Creates a BTree holding the n given position-value pairs (points[i] is
+ * associated to values[i]). The coordinates of the points are copied in the
+ * tree: the Point objects are not referenced after the call. The leaves are
+ * filled completely, the tree being meant to be searched more than updated.
+ *
+ * The BTree must later be deleted by calling btFree().
+ *
+ * PARAMETERS
+ * points         An array of n positions (Point objects)
+ * values         An array of n values
+ * n              The number of position-value pairs
+ *
+ * RETURN
+ * bt             A pointer to the BTree, or NULL in case of allocation error
+ * ------------------------------------------------------------------------- */
+
+BTree *btBuildFromArrays(Point **points, void **values, size_t n);
+
+/* ------------------------------------------------------------------------- *
+ * Frees the allocated memory of the given BTree.
+ *
+ * PARAMETERS
+ * bt             A valid pointer to a BTree object
+ * freeValue      Whether to free the values
+ *
+ * ------------------------------------------------------------------------- */
+
+void btFree(BTree *bt, bool freeValue);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the number of positions stored in the given BTree.
+ *
+ * PARAMETERS
+ * bt             A valid pointer to a BTree object
+ *
+ * RETURN
+ * nb             The number of positions stored in bt
+ * ------------------------------------------------------------------------- */
+
+size_t btSize(BTree *bt);
+
+/* ------------------------------------------------------------------------- *
+ * Returns the value associated to a position, if any. If several values are
+ * associated to this position, any one of them is returned.
+ *
+ * PARAMETERS
+ * bt             A valid pointer to a BTree object
+ * q              The position to look for
+ *
+ * RETURN
+ * res            One of the value corresponding to that position. Or NULL if
+ *                the position is not present in the BTree
+ * ------------------------------------------------------------------------- */
+
+void *btSearch(BTree *bt, Point *q);
+
+/* ------------------------------------------------------------------------- *
+ * Removes an element from the provided BTree. Since positions may be
+ * duplicated, the element is identified by its position and its value
+ * (compared as a pointer). The value is not freed. The nodes are not
+ * merged: leaves may become empty.
+ *
+ * PARAMETERS
+ * bt             A valid pointer to a BTree object
+ * q              The position of the element
+ * value          The value of the element
+ *
+ * RETURN
+ * res            A boolean equal to true if the element was found and
+ *                removed, false otherwise
+ * ------------------------------------------------------------------------- */
+
+bool btRemove(BTree *bt, Point *q, void *value);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the set of positions in the provided BTree that are included in a
+ * ball of radius r and centered at the position q given as argument. The
+ * function returns a list of the values associated to these positions (in
+ * the order of ptCompare).
+ *
+ * PARAMETERS
+ * bt             A valid pointer to a BTree object
+ * q              The center of the ball
+ * r              The radius of the ball
+ *
+ * RETURN
+ * l              A List containing the values in the given ball, or
+ *                NULL in case of allocation error.
+ *
+ * NOTES
+ * The List must be freed but not its content. If no elements are in the
+ * ball, the function returns an empty list
+ * ------------------------------------------------------------------------- */
+
+List *btBallSearch(BTree *bt, Point *q, double r);
+
+/* ------------------------------------------------------------------------- *
+ * Passes the value of every position of the provided BTree that is
+ * included in a ball of radius r and centered at the position q to a
+ * callback. The leaves holding the x coordinates of the ball are scanned
+ * and each position is tested against the ball: no list is built, and the
+ * search stops as soon as the callback returns false.
+ *
+ * PARAMETERS
+ * bt             A valid pointer to a BTree object
+ * q              The center of the ball
+ * r              The radius of the ball
+ * visit          The callback, called as visit(value, ctx). It returns true
+ *                to continue the search, false to stop it
+ * ctx            A pointer passed unchanged to the callback
+ *
+ * RETURN
+ * res            A boolean equal to false if the callback stopped the
+ *                search, true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool btBallVisit(BTree *bt, Point *q, double r,
+                 bool visit(void *value, void *ctx), void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the positions of the provided BTree that are included in a ball
+ * of radius r and centered at the position q. Nothing is allocated.
+ *
+ * PARAMETERS
+ * bt             A valid pointer to a BTree object
+ * q              The center of the ball
+ * r              The radius of the ball
+ *
+ * RETURN
+ * nb             The number of positions in the ball
+ * ------------------------------------------------------------------------- */
+
+size_t btBallCount(BTree *bt, Point *q, double r);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the k positions of the provided BTree that are the closest to the
+ * position q and returns their values, sorted by increasing distance to q.
+ * The leaves are scanned from q towards both ends, until the gap in x alone
+ * exceeds the k-th best distance. Ties are broken arbitrarily.
+ *
+ * PARAMETERS
+ * bt             A valid pointer to a BTree object
+ * q              The query position
+ * k              The number of neighbours to look for
+ *
+ * RETURN
+ * l              A List containing the values of the min(k, size) nearest
+ *                positions, or NULL in case of allocation error.
+ *
+ * NOTES
+ * The List must be freed but not its content.
+ * ------------------------------------------------------------------------- */
+
+List *btKNearest(BTree *bt, Point *q, size_t k);
+
+#endif // !_BTREE_H_
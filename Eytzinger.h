@@ -0,0 +1,82 @@
+/* ========================================================================= *
+ * Eytzinger interface:
+ * The walks of an implicit binary search tree stored in Eytzinger
+ * (breadth-first) order, shared by the frozen BST and by the trees of
+ * BSTTemplate.h. The n slots of the array are numbered from 1, the children
+ * of slot k being 2k and 2k + 1; the slot 0 is unused and stands for none.
+ * ========================================================================= */
+
+#ifndef _EYTZINGER_H_
+#define _EYTZINGER_H_
+
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- *
+ * Finds the first slot of the in-order walk of an Eytzinger array.
+ *
+ * PARAMETERS
+ * n            The number of slots of the array.
+ *
+ * RETURN
+ * first        The leftmost slot, or 0 if the array is empty.
+ * ------------------------------------------------------------------------- */
+
+static inline size_t eytzingerFirst(size_t n)
+{
+    size_t k = (n > 0) ? 1 : 0;
+    while (k != 0 && 2 * k <= n)
+        k = 2 * k;
+    return k;
+}
+
+/* ------------------------------------------------------------------------- *
+ * Finds the slot following a given one in the in-order walk of an
+ * Eytzinger array.
+ *
+ * PARAMETERS
+ * k            A slot of the array (1 <= k <= n).
+ * n            The number of slots of the array.
+ *
+ * RETURN
+ * next         The next slot, or 0 if k is the last one.
+ * ------------------------------------------------------------------------- */
+
+static inline size_t eytzingerNext(size_t k, size_t n)
+{
+    if (2 * k + 1 <= n)
+    {
+        // the leftmost slot of the right subtree
+        k = 2 * k + 1;
+        while (2 * k <= n)
+            k = 2 * k;
+        return k;
+    }
+    // up to the first ancestor whose left subtree contains k
+    while (k & 1)
+        k >>= 1;
+    return k >> 1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * Finds the lower bound reached by a descent of an Eytzinger array. The
+ * descent goes from slot k to 2k + 1 if the key of k is lower than the key
+ * searched, to 2k otherwise, until it leaves the array.
+ *
+ * PARAMETERS
+ * k            The first slot of the descent out of the array (k > n).
+ *
+ * RETURN
+ * bound        The slot of the first key greater than or equal to the key
+ *              searched, or 0 if all the keys are lower.
+ * ------------------------------------------------------------------------- */
+
+static inline size_t eytzingerLowerBound(size_t k)
+{
+    // the last left turn of the descent leads to the lower bound: the
+    // right turns taken since then are the trailing ones of k
+    while (k & 1)
+        k >>= 1;
+    return k >> 1;
+}
+
+#endif // !_EYTZINGER_H_
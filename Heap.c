@@ -0,0 +1,180 @@
+/* ========================================================================= *
+ * Heap definition
+ * ========================================================================= */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Heap.h"
+#include "List.h"
+
+/* Opaque Structure */
+
+typedef struct HNode_t HNode;
+
+struct HNode_t
+{
+    double priority;
+    void *value;
+};
+
+struct Heap_t
+{
+    HNode *nodes;
+    size_t size;
+    size_t capacity;
+};
+
+/* Prototypes of static functions */
+
+/* ------------------------------------------------------------------------- *
+ * Moves the element at index i up until its parent has a larger priority.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a Heap object.
+ * i            The index of the element.
+ *
+ * ------------------------------------------------------------------------- */
+static void siftUp(Heap *h, size_t i);
+
+/* ------------------------------------------------------------------------- *
+ * Moves the element at index i down until its children have smaller
+ * priorities.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a Heap object.
+ * i            The index of the element.
+ *
+ * ------------------------------------------------------------------------- */
+static void siftDown(Heap *h, size_t i);
+
+/* Function definitions */
+
+Heap *heapNew(size_t capacity)
+{
+    Heap *h = malloc(sizeof(Heap));
+    if (h == NULL)
+    {
+        printf("heapNew: allocation error\n");
+        return NULL;
+    }
+    if (capacity == 0)
+        capacity = 1;
+    // the size of the array would wrap around
+    h->nodes = (capacity <= SIZE_MAX / sizeof(HNode))
+                   ? malloc(capacity * sizeof(HNode))
+                   : NULL;
+    if (h->nodes == NULL)
+    {
+        printf("heapNew: allocation error\n");
+        free(h);
+        return NULL;
+    }
+    h->size = 0;
+    h->capacity = capacity;
+    return h;
+}
+
+void heapFree(Heap *h)
+{
+    free(h->nodes);
+    free(h);
+}
+
+size_t heapSize(Heap *h)
+{
+    return h->size;
+}
+
+void siftUp(Heap *h, size_t i)
+{
+    HNode node = h->nodes[i];
+    while (i > 0 && h->nodes[(i - 1) / 2].priority < node.priority)
+    {
+        h->nodes[i] = h->nodes[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->nodes[i] = node;
+}
+
+void siftDown(Heap *h, size_t i)
+{
+    HNode node = h->nodes[i];
+    size_t child;
+    while ((child = 2 * i + 1) < h->size)
+    {
+        if (child + 1 < h->size && h->nodes[child + 1].priority > h->nodes[child].priority)
+            child++;
+        if (h->nodes[child].priority <= node.priority)
+            break;
+        h->nodes[i] = h->nodes[child];
+        i = child;
+    }
+    h->nodes[i] = node;
+}
+
+bool heapPush(Heap *h, double priority, void *value)
+{
+    if (h->size == h->capacity)
+    {
+        if (h->capacity > SIZE_MAX / (2 * sizeof(HNode)))
+            return false;
+        HNode *nodes = realloc(h->nodes, 2 * h->capacity * sizeof(HNode));
+        if (nodes == NULL)
+            return false;
+        h->nodes = nodes;
+        h->capacity *= 2;
+    }
+    h->nodes[h->size].priority = priority;
+    h->nodes[h->size].value = value;
+    siftUp(h, h->size++);
+    return true;
+}
+
+double heapMaxPriority(Heap *h)
+{
+    return h->nodes[0].priority;
+}
+
+void *heapPopMax(Heap *h)
+{
+    void *value = h->nodes[0].value;
+    h->nodes[0] = h->nodes[--h->size];
+    if (h->size > 0)
+        siftDown(h, 0);
+    return value;
+}
+
+bool heapOfferBounded(Heap *h, size_t k, double priority, void *value)
+{
+    if (h->size < k)
+        return heapPush(h, priority, value);
+    if (k > 0 && priority < h->nodes[0].priority)
+    {
+        // replace the largest element in place
+        h->nodes[0].priority = priority;
+        h->nodes[0].value = value;
+        siftDown(h, 0);
+    }
+    return true;
+}
+
+List *heapToSortedList(Heap *h)
+{
+    List *l = listNew();
+    if (l == NULL)
+        return NULL;
+    // the largest priorities come out first, hence the insertions at the head
+    while (h->size > 0)
+    {
+        if (!listInsertFirst(l, heapPopMax(h)))
+        {
+            listFree(l, false);
+            return NULL;
+        }
+    }
+    return l;
+}
@@ -0,0 +1,126 @@
+/* ========================================================================= *
+ * Heap interface:
+ * A max-heap of values ordered by a priority (a double).
+ * ========================================================================= */
+
+#ifndef _HEAP_H_
+#define _HEAP_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "List.h"
+
+/* Opaque Structure */
+typedef struct Heap_t Heap;
+
+/* ------------------------------------------------------------------------- *
+ * Creates an empty Heap.
+ *
+ * The Heap must later be deleted by calling heapFree().
+ *
+ * PARAMETERS
+ * capacity     The number of elements for which memory is reserved (the
+ *              heap grows beyond it if needed)
+ *
+ * RETURN
+ * h            A pointer to the Heap, or NULL in case of error
+ * ------------------------------------------------------------------------- */
+
+Heap *heapNew(size_t capacity);
+
+/* ------------------------------------------------------------------------- *
+ * Frees the allocated memory of the given Heap. The values are not freed.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a Heap object
+ * ------------------------------------------------------------------------- */
+
+void heapFree(Heap *h);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the number of elements stored in the given Heap.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a Heap object
+ *
+ * RETURN
+ * nb           The amount of elements stored in h
+ * ------------------------------------------------------------------------- */
+
+size_t heapSize(Heap *h);
+
+/* ------------------------------------------------------------------------- *
+ * Inserts a new element in the Heap.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a Heap object
+ * priority     The priority of the element
+ * value        The value to store
+ *
+ * RETURN
+ * res          A boolean equal to true if the new element was successfully
+ *              inserted, false otherwise (error)
+ * ------------------------------------------------------------------------- */
+
+bool heapPush(Heap *h, double priority, void *value);
+
+/* ------------------------------------------------------------------------- *
+ * Returns the largest priority in the Heap.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a non-empty Heap object
+ *
+ * RETURN
+ * priority     The largest priority of the elements of h
+ * ------------------------------------------------------------------------- */
+
+double heapMaxPriority(Heap *h);
+
+/* ------------------------------------------------------------------------- *
+ * Removes the element with the largest priority and returns its value.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a non-empty Heap object
+ *
+ * RETURN
+ * value        The value of the removed element
+ * ------------------------------------------------------------------------- */
+
+void *heapPopMax(Heap *h);
+
+/* ------------------------------------------------------------------------- *
+ * Offers an element to a Heap used to keep the k elements with the smallest
+ * priorities: the element is inserted if the heap holds less than k
+ * elements, or replaces the element of largest priority if its own priority
+ * is smaller.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a Heap object
+ * k            The maximum number of elements to keep
+ * priority     The priority of the element
+ * value        The value to store
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error, true
+ *              otherwise
+ * ------------------------------------------------------------------------- */
+
+bool heapOfferBounded(Heap *h, size_t k, double priority, void *value);
+
+/* ------------------------------------------------------------------------- *
+ * Empties the Heap and returns its values by increasing priorities.
+ *
+ * PARAMETERS
+ * h            A valid pointer to a Heap object
+ *
+ * RETURN
+ * l            A List containing the values, or NULL in case of allocation
+ *              error.
+ *
+ * NOTES
+ * The list must be freed but not its content.
+ * ------------------------------------------------------------------------- */
+
+List *heapToSortedList(Heap *h);
+
+#endif // !_HEAP_H_
@@ -0,0 +1,640 @@
+/* ========================================================================= *
+ * KdTree definition
+ * ========================================================================= */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "KdTree.h"
+#include "Point.h"
+#include "List.h"
+#include "Heap.h"
+#include "Scan.h"
+
+// Number of positions stored in a leaf. A leaf only exceeds it when all its
+// positions are identical, since they cannot be split.
+#define KDT_LEAF_SIZE 32
+
+/* Opaque Structure */
+
+typedef struct KNode_t KNode;
+
+struct KNode_t
+{
+    // bounding box of the positions of the subtree rooted at this node
+    double xmin;
+    double xmax;
+    double ymin;
+    double ymax;
+    // internal nodes: positions with coord <= split are on the left
+    KNode *left;
+    KNode *right;
+    double split;
+    int axis;
+    // number of positions in the subtree
+    size_t size;
+    // leaves (left == right == NULL): structure of arrays of the positions
+    double *x;
+    double *y;
+    void **values;
+};
+
+struct KdTree_t
+{
+    KNode *root;
+    size_t size;
+};
+
+typedef struct Entry_t Entry;
+
+struct Entry_t
+{
+    double x;
+    double y;
+    void *value;
+};
+
+/* Prototypes of static functions */
+
+/* ------------------------------------------------------------------------- *
+ * Frees the allocated memory of the subtree rooted at the given node.
+ *
+ * PARAMETERS
+ * n            A pointer to a node object (possibly NULL).
+ * freeValue    Whether to free the values.
+ *
+ * ------------------------------------------------------------------------- */
+static void kdtFreeRec(KNode *n, bool freeValue);
+
+/* ------------------------------------------------------------------------- *
+ * Creates a new node whose bounding box is the one of the given entries.
+ *
+ * PARAMETERS
+ * entries      The entries of the subtree rooted at the node.
+ * n            The number of entries (at least 1).
+ *
+ * RETURN
+ * KNode        A pointer to the node, or NULL in case of error.
+ * ------------------------------------------------------------------------- */
+static KNode *knNew(Entry *entries, size_t n);
+
+/* ------------------------------------------------------------------------- *
+ * Turns a node into a leaf storing the given entries.
+ *
+ * PARAMETERS
+ * node         A valid pointer to a node object.
+ * entries      The entries of the leaf.
+ * n            The number of entries.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool knMakeLeaf(KNode *node, Entry *entries, size_t n);
+
+/* ------------------------------------------------------------------------- *
+ * Rearranges the entries around the k-th smallest coordinate v on an axis
+ * (quickselect with a three-way partition, linear expected time). On
+ * return, the entries in [0, *lo) have a coordinate < v, those in
+ * [*lo, *hi) are equal to v and those in [*hi, n) are > v.
+ *
+ * PARAMETERS
+ * entries      The entries to rearrange.
+ * n            The number of entries.
+ * k            The rank of the coordinate to select.
+ * axis         0 for the x coordinate, 1 for the y coordinate.
+ * lo, hi       Set to the bounds of the block of entries equal to v.
+ *
+ * ------------------------------------------------------------------------- */
+static void entriesSelect(Entry *entries, size_t n, size_t k, int axis,
+                          size_t *lo, size_t *hi);
+
+/* ------------------------------------------------------------------------- *
+ * Builds a subtree from an array of entries, splitting the widest side of
+ * the bounding box on the median coordinate until at most KDT_LEAF_SIZE
+ * entries remain.
+ *
+ * PARAMETERS
+ * entries      The entries of the subtree (rearranged by the function).
+ * n            The number of entries (at least 1).
+ * error        Set to true in case of allocation error.
+ *
+ * RETURN
+ * n            The root of the subtree.
+ * ------------------------------------------------------------------------- */
+static KNode *kdtBuildRec(Entry *entries, size_t n, bool *error);
+
+/* ------------------------------------------------------------------------- *
+ * Computes the square of the smallest distance between a position and the
+ * bounding box of a node (0 if the position is inside).
+ *
+ * PARAMETERS
+ * n            A valid pointer to a node object.
+ * x, y         The coordinates of the position.
+ *
+ * RETURN
+ * d            The square distance between (x, y) and the box of n.
+ * ------------------------------------------------------------------------- */
+static double boxSqrDistance(KNode *n, double x, double y);
+
+/* ------------------------------------------------------------------------- *
+ * Computes the square of the largest distance between a position and the
+ * bounding box of a node.
+ *
+ * PARAMETERS
+ * n            A valid pointer to a node object.
+ * x, y         The coordinates of the position.
+ *
+ * RETURN
+ * d            The square distance between (x, y) and the farthest corner
+ *              of the box of n.
+ * ------------------------------------------------------------------------- */
+static double boxSqrMaxDistance(KNode *n, double x, double y);
+
+/* ------------------------------------------------------------------------- *
+ * Passes to the callback the values of the subtree rooted at n whose
+ * positions lie in the ball of center (qx, qy) and square radius r2.
+ *
+ * PARAMETERS
+ * n            A valid pointer to a node object.
+ * qx, qy       The center of the ball.
+ * r2           The square of the radius of the ball.
+ * visit        The callback.
+ * ctx          The context passed to the callback.
+ *
+ * RETURN
+ * res          A boolean equal to false if the callback stopped the search,
+ *              true otherwise.
+ * ------------------------------------------------------------------------- */
+static bool kdtBallVisitRec(KNode *n, double qx, double qy, double r2,
+                            bool visit(void *, void *), void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Passes to the callback all the values of the subtree rooted at n.
+ *
+ * PARAMETERS
+ * n            A valid pointer to a node object.
+ * visit        The callback.
+ * ctx          The context passed to the callback.
+ *
+ * RETURN
+ * res          A boolean equal to false if the callback stopped the walk,
+ *              true otherwise.
+ * ------------------------------------------------------------------------- */
+static bool kdtVisitAllRec(KNode *n, bool visit(void *, void *), void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Inserts a value at the end of a list (callback of kdtBallVisit used by
+ * kdtBallSearch).
+ *
+ * PARAMETERS
+ * value        The value to insert.
+ * l            A valid pointer to a list object.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool collect(void *value, void *l);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the positions of the subtree rooted at n that lie in the ball of
+ * center (qx, qy) and square radius r2.
+ *
+ * PARAMETERS
+ * n            A valid pointer to a node object.
+ * qx, qy       The center of the ball.
+ * r2           The square of the radius of the ball.
+ *
+ * RETURN
+ * nb           The number of positions of the subtree in the ball.
+ * ------------------------------------------------------------------------- */
+static size_t kdtBallCountRec(KNode *n, double qx, double qy, double r2);
+
+/* ------------------------------------------------------------------------- *
+ * Collects the k nearest neighbours of (qx, qy) in the subtree rooted at n,
+ * exploring the child on the side of the query first.
+ *
+ * PARAMETERS
+ * n            A valid pointer to a node object.
+ * qx, qy       The query position.
+ * k            The number of neighbours to look for.
+ * heap         A max-heap holding the (at most k) best candidates so far,
+ *              with their square distances as priorities.
+ * error        A boolean value to detect if errors occur inside the function.
+ *
+ * ------------------------------------------------------------------------- */
+static void kdtKNearestRec(KNode *n, double qx, double qy, size_t k,
+                           Heap *heap, bool *error);
+
+/* Function definitions */
+
+KNode *knNew(Entry *entries, size_t n)
+{
+    KNode *node = malloc(sizeof(KNode));
+    if (node == NULL)
+    {
+        printf("knNew: allocation error\n");
+        return NULL;
+    }
+    node->xmin = node->xmax = entries[0].x;
+    node->ymin = node->ymax = entries[0].y;
+    for (size_t i = 1; i < n; i++)
+    {
+        if (entries[i].x < node->xmin)
+            node->xmin = entries[i].x;
+        if (entries[i].x > node->xmax)
+            node->xmax = entries[i].x;
+        if (entries[i].y < node->ymin)
+            node->ymin = entries[i].y;
+        if (entries[i].y > node->ymax)
+            node->ymax = entries[i].y;
+    }
+    node->left = NULL;
+    node->right = NULL;
+    node->split = 0.0;
+    node->axis = 0;
+    node->size = 0;
+    node->x = NULL;
+    node->y = NULL;
+    node->values = NULL;
+    return node;
+}
+
+bool knMakeLeaf(KNode *node, Entry *entries, size_t n)
+{
+    size_t capacity = (n > KDT_LEAF_SIZE) ? n : KDT_LEAF_SIZE;
+    // the three arrays share a single allocation
+    double *block = malloc(capacity * (2 * sizeof(double) + sizeof(void *)));
+    if (block == NULL)
+    {
+        printf("knMakeLeaf: allocation error\n");
+        return false;
+    }
+    node->x = block;
+    node->y = block + capacity;
+    node->values = (void **)(block + 2 * capacity);
+    for (size_t i = 0; i < n; i++)
+    {
+        node->x[i] = entries[i].x;
+        node->y[i] = entries[i].y;
+        node->values[i] = entries[i].value;
+    }
+    node->size = n;
+    return true;
+}
+
+void entriesSelect(Entry *entries, size_t n, size_t k, int axis, size_t *lo,
+                   size_t *hi)
+{
+    size_t first = 0, last = n;
+    while (true)
+    {
+        // median of three as pivot, so that sorted inputs stay linear
+        Entry *ea = &entries[first];
+        Entry *eb = &entries[first + (last - first) / 2];
+        Entry *ec = &entries[last - 1];
+        double a = axis ? ea->y : ea->x;
+        double b = axis ? eb->y : eb->x;
+        double c = axis ? ec->y : ec->x;
+        double pivot = (a < b) ? ((b < c) ? b : ((a < c) ? c : a))
+                               : ((a < c) ? a : ((b < c) ? c : b));
+
+        // three-way partition of [first, last): < pivot | = pivot | > pivot
+        size_t lt = first, i = first, gt = last;
+        while (i < gt)
+        {
+            double ci = axis ? entries[i].y : entries[i].x;
+            Entry tmp = entries[i];
+            if (ci < pivot)
+            {
+                entries[i++] = entries[lt];
+                entries[lt++] = tmp;
+            }
+            else if (ci > pivot)
+            {
+                entries[i] = entries[--gt];
+                entries[gt] = tmp;
+            }
+            else
+                i++;
+        }
+
+        if (k < lt)
+            last = lt;
+        else if (k >= gt)
+            first = gt;
+        else
+        {
+            *lo = lt;
+            *hi = gt;
+            return;
+        }
+    }
+}
+
+KNode *kdtBuildRec(Entry *entries, size_t n, bool *error)
+{
+    KNode *node = knNew(entries, n);
+    if (node == NULL)
+    {
+        *error = true;
+        return NULL;
+    }
+
+    // identical positions cannot be split: they share an oversized leaf
+    bool identical = (node->xmin == node->xmax && node->ymin == node->ymax);
+    if (n <= KDT_LEAF_SIZE || identical)
+    {
+        *error = !knMakeLeaf(node, entries, n);
+        return node;
+    }
+
+    node->axis = (node->xmax - node->xmin >= node->ymax - node->ymin) ? 0 : 1;
+    size_t lo, hi;
+    entriesSelect(entries, n, n / 2, node->axis, &lo, &hi);
+    size_t mid;
+    if (hi < n)
+    {
+        // the median and everything equal to it go to the left
+        node->split = node->axis ? entries[hi - 1].y : entries[hi - 1].x;
+        mid = hi;
+    }
+    else
+    {
+        // nothing is above the median: split just below it instead (the
+        // side is not flat, so some entries are smaller than the median)
+        node->split = node->axis ? entries[0].y : entries[0].x;
+        for (size_t i = 1; i < lo; i++)
+        {
+            double c = node->axis ? entries[i].y : entries[i].x;
+            if (c > node->split)
+                node->split = c;
+        }
+        mid = lo;
+    }
+
+    node->size = n;
+    node->left = kdtBuildRec(entries, mid, error);
+    if (!*error)
+        node->right = kdtBuildRec(entries + mid, n - mid, error);
+    return node;
+}
+
+KdTree *kdtBuildFromArrays(Point **points, void **values, size_t n)
+{
+    KdTree *kdt = malloc(sizeof(KdTree));
+    if (kdt == NULL)
+    {
+        printf("kdtBuildFromArrays: allocation error\n");
+        return NULL;
+    }
+    kdt->root = NULL;
+    kdt->size = n;
+    if (n == 0)
+        return kdt;
+
+    Entry *entries = malloc(n * sizeof(Entry));
+    if (entries == NULL)
+    {
+        printf("kdtBuildFromArrays: allocation error\n");
+        free(kdt);
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        entries[i].x = ptGetx(points[i]);
+        entries[i].y = ptGety(points[i]);
+        entries[i].value = values[i];
+    }
+
+    bool error = false;
+    kdt->root = kdtBuildRec(entries, n, &error);
+    free(entries);
+    if (error)
+    {
+        kdtFree(kdt, false);
+        return NULL;
+    }
+    return kdt;
+}
+
+void kdtFree(KdTree *kdt, bool freeValue)
+{
+    kdtFreeRec(kdt->root, freeValue);
+    free(kdt);
+}
+
+void kdtFreeRec(KNode *n, bool freeValue)
+{
+    if (n == NULL)
+        return;
+    kdtFreeRec(n->left, freeValue);
+    kdtFreeRec(n->right, freeValue);
+    if (freeValue && n->left == NULL)
+    {
+        for (size_t i = 0; i < n->size; i++)
+            free(n->values[i]);
+    }
+    free(n->x);
+    free(n);
+}
+
+size_t kdtSize(KdTree *kdt)
+{
+    return kdt->size;
+}
+
+void *kdtSearch(KdTree *kdt, Point *q)
+{
+    KNode *n = kdt->root;
+    if (n == NULL)
+        return NULL;
+    double x = ptGetx(q), y = ptGety(q);
+    while (n->left != NULL)
+    {
+        double c = n->axis ? y : x;
+        n = (c <= n->split) ? n->left : n->right;
+    }
+    for (size_t i = 0; i < n->size; i++)
+    {
+        if (n->x[i] == x && n->y[i] == y)
+            return n->values[i];
+    }
+    return NULL;
+}
+
+bool kdtRemove(KdTree *kdt, Point *q, void *value)
+{
+    KNode *n = kdt->root;
+    if (n == NULL)
+        return false;
+    double x = ptGetx(q), y = ptGety(q);
+    while (n->left != NULL)
+    {
+        double c = n->axis ? y : x;
+        n = (c <= n->split) ? n->left : n->right;
+    }
+    size_t i = 0;
+    while (i < n->size && !(n->x[i] == x && n->y[i] == y && n->values[i] == value))
+        i++;
+    if (i == n->size)
+        return false;
+
+    // the last position of the leaf takes the place of the removed one
+    KNode *leaf = n;
+    leaf->size--;
+    leaf->x[i] = leaf->x[leaf->size];
+    leaf->y[i] = leaf->y[leaf->size];
+    leaf->values[i] = leaf->values[leaf->size];
+
+    // the bounding boxes are left as they are: larger than needed, they
+    // still bound the positions of their subtree
+    for (n = kdt->root; n != leaf; n = ((n->axis ? y : x) <= n->split) ? n->left : n->right)
+        n->size--;
+    kdt->size--;
+    return true;
+}
+
+double boxSqrDistance(KNode *n, double x, double y)
+{
+    double dx = (x < n->xmin) ? n->xmin - x : ((x > n->xmax) ? x - n->xmax : 0.0);
+    double dy = (y < n->ymin) ? n->ymin - y : ((y > n->ymax) ? y - n->ymax : 0.0);
+    return dx * dx + dy * dy;
+}
+
+double boxSqrMaxDistance(KNode *n, double x, double y)
+{
+    double dx = (x - n->xmin > n->xmax - x) ? x - n->xmin : n->xmax - x;
+    double dy = (y - n->ymin > n->ymax - y) ? y - n->ymin : n->ymax - y;
+    return dx * dx + dy * dy;
+}
+
+bool collect(void *value, void *l)
+{
+    return listInsertLast(l, value);
+}
+
+List *kdtBallSearch(KdTree *kdt, Point *q, double r)
+{
+    List *list = listNew();
+    if (list == NULL)
+        return NULL;
+    if (!kdtBallVisit(kdt, q, r, collect, list))
+    {
+        listFree(list, false);
+        return NULL;
+    }
+    return list;
+}
+
+bool kdtBallVisit(KdTree *kdt, Point *q, double r,
+                  bool visit(void *value, void *ctx), void *ctx)
+{
+    if (kdt->root == NULL)
+        return true;
+    return kdtBallVisitRec(kdt->root, ptGetx(q), ptGety(q), r * r, visit, ctx);
+}
+
+bool kdtBallVisitRec(KNode *n, double qx, double qy, double r2,
+                     bool visit(void *, void *), void *ctx)
+{
+    if (boxSqrDistance(n, qx, qy) > r2)
+        return true;
+
+    // the ball covers the whole subtree: no distance test is needed
+    if (boxSqrMaxDistance(n, qx, qy) <= r2)
+        return kdtVisitAllRec(n, visit, ctx);
+
+    if (n->left != NULL)
+    {
+        return kdtBallVisitRec(n->left, qx, qy, r2, visit, ctx)
+            && kdtBallVisitRec(n->right, qx, qy, r2, visit, ctx);
+    }
+
+    // leaf: filter its positions by blocks of (at most) KDT_LEAF_SIZE
+    size_t indices[KDT_LEAF_SIZE];
+    for (size_t start = 0; start < n->size; start += KDT_LEAF_SIZE)
+    {
+        size_t len = (n->size - start < KDT_LEAF_SIZE) ? n->size - start : KDT_LEAF_SIZE;
+        size_t found = scanBall(n->x + start, n->y + start, len, qx, qy, r2, indices);
+        for (size_t i = 0; i < found; i++)
+        {
+            if (!visit(n->values[start + indices[i]], ctx))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool kdtVisitAllRec(KNode *n, bool visit(void *, void *), void *ctx)
+{
+    if (n->left != NULL)
+        return kdtVisitAllRec(n->left, visit, ctx) && kdtVisitAllRec(n->right, visit, ctx);
+    for (size_t i = 0; i < n->size; i++)
+    {
+        if (!visit(n->values[i], ctx))
+            return false;
+    }
+    return true;
+}
+
+size_t kdtBallCount(KdTree *kdt, Point *q, double r)
+{
+    if (kdt->root == NULL)
+        return 0;
+    return kdtBallCountRec(kdt->root, ptGetx(q), ptGety(q), r * r);
+}
+
+size_t kdtBallCountRec(KNode *n, double qx, double qy, double r2)
+{
+    if (boxSqrDistance(n, qx, qy) > r2)
+        return 0;
+    if (boxSqrMaxDistance(n, qx, qy) <= r2)
+        return n->size;
+    if (n->left != NULL)
+        return kdtBallCountRec(n->left, qx, qy, r2) + kdtBallCountRec(n->right, qx, qy, r2);
+    return scanBallCount(n->x, n->y, n->size, qx, qy, r2);
+}
+
+List *kdtKNearest(KdTree *kdt, Point *q, size_t k)
+{
+    // no more than the stored positions can be returned: the heap is sized
+    // for them, whatever k is
+    if (k > kdt->size)
+        k = kdt->size;
+    Heap *heap = heapNew(k);
+    if (heap == NULL)
+        return NULL;
+
+    bool error = false;
+    if (k > 0 && kdt->root != NULL)
+        kdtKNearestRec(kdt->root, ptGetx(q), ptGety(q), k, heap, &error);
+    List *list = error ? NULL : heapToSortedList(heap);
+    heapFree(heap);
+    return list;
+}
+
+void kdtKNearestRec(KNode *n, double qx, double qy, size_t k, Heap *heap,
+                    bool *error)
+{
+    if (*error)
+        return;
+
+    if (n->left == NULL)
+    {
+        for (size_t i = 0; i < n->size && !*error; i++)
+        {
+            double dx = n->x[i] - qx;
+            double dy = n->y[i] - qy;
+            *error = !heapOfferBounded(heap, k, dx * dx + dy * dy, n->values[i]);
+        }
+        return;
+    }
+
+    bool leftFirst = ((n->axis ? qy : qx) <= n->split);
+    KNode *near = leftFirst ? n->left : n->right;
+    KNode *far = leftFirst ? n->right : n->left;
+    kdtKNearestRec(near, qx, qy, k, heap, error);
+    if (heapSize(heap) < k || boxSqrDistance(far, qx, qy) <= heapMaxPriority(heap))
+        kdtKNearestRec(far, qx, qy, k, heap, error);
+}
@@ -0,0 +1,173 @@
+/* ========================================================================= *
+ * KdTree interface:
+ * A kd-tree whose leaves are buckets of positions. The positions of a leaf
+ * are stored as a structure of arrays (x[], y[] and values[]) so that they
+ * can be filtered with vectorized distance computations.
+ * ========================================================================= */
+
+#ifndef _KDTREE_H_
+#define _KDTREE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "Point.h"
+#include "List.h"
+
+/* Opaque Structure */
+typedef struct KdTree_t KdTree;
+
+/* ------------------------------------------------------------------------- *
+ * Creates a KdTree holding the n given position-value pairs (points[i] is
+ * associated to values[i]). The coordinates of the points are copied in the
+ * tree: the Point objects are not referenced after the call.
+ *
+ * The KdTree must later be deleted by calling kdtFree().
+ *
+ * PARAMETERS
+ * points         An array of n positions (Point objects)
+ * values         An array of n values
+ * n              The number of position-value pairs
+ *
+ * RETURN
+ * kdt            A pointer to the KdTree, or NULL in case of error
+ * ------------------------------------------------------------------------- */
+
+KdTree *kdtBuildFromArrays(Point **points, void **values, size_t n);
+
+/* ------------------------------------------------------------------------- *
+ * Frees the allocated memory of the given KdTree.
+ *
+ * PARAMETERS
+ * kdt            A valid pointer to a KdTree object
+ * freeValue      Whether to free the values.
+ *
+ * ------------------------------------------------------------------------- */
+
+void kdtFree(KdTree *kdt, bool freeValue);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the number of elements stored in the given KdTree.
+ *
+ * PARAMETERS
+ * kdt            A valid pointer to a KdTree object
+ *
+ * RETURN
+ * nb             The amount of elements stored in kdt
+ * ------------------------------------------------------------------------- */
+
+size_t kdtSize(KdTree *kdt);
+
+/* ------------------------------------------------------------------------- *
+ * Returns the value associated to a position, if any. If several values are
+ * associated to this position, any one of them is returned.
+ *
+ * PARAMETERS
+ * kdt            A valid pointer to a KdTree object
+ * q              The position to look for
+ *
+ * RETURN
+ * res            One of the value corresponding to that position. Or NULL if
+ *                the position is not present in the KdTree
+ * ------------------------------------------------------------------------- */
+
+void *kdtSearch(KdTree *kdt, Point *q);
+
+/* ------------------------------------------------------------------------- *
+ * Removes an element from the provided KdTree. Since positions may be
+ * duplicated, the element is identified by its position and its value
+ * (compared as a pointer). The value is not freed. The tree is not
+ * rebalanced: leaves may become empty.
+ *
+ * PARAMETERS
+ * kdt            A valid pointer to a KdTree object
+ * q              The position of the element
+ * value          The value of the element
+ *
+ * RETURN
+ * res            A boolean equal to true if the element was found and
+ *                removed, false otherwise
+ * ------------------------------------------------------------------------- */
+
+bool kdtRemove(KdTree *kdt, Point *q, void *value);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the set of positions in the provided KdTree that are included in a
+ * ball of radius r and centered at the position q given as argument. The
+ * function returns a list of the values associated to these positions (in
+ * no particular order).
+ *
+ * PARAMETERS
+ * kdt            A valid pointer to a KdTree object
+ * q              The center of the ball
+ * r              The radius of the ball
+ *
+ * RETURN
+ * l              A List containing the values in the given ball, or
+ *                NULL in case of allocation error.
+ *
+ * NOTES
+ * The List must be freed but not its content. If no elements are in the
+ * ball, the function returns an empty list
+ * ------------------------------------------------------------------------- */
+
+List *kdtBallSearch(KdTree *kdt, Point *q, double r);
+
+/* ------------------------------------------------------------------------- *
+ * Passes the value of every position of the provided KdTree that is
+ * included in a ball of radius r and centered at the position q to a
+ * callback (in no particular order). No list is built: the search stops as
+ * soon as the callback returns false.
+ *
+ * PARAMETERS
+ * kdt            A valid pointer to a KdTree object
+ * q              The center of the ball
+ * r              The radius of the ball
+ * visit          The callback, called as visit(value, ctx). It returns true
+ *                to continue the search, false to stop it
+ * ctx            A pointer passed unchanged to the callback
+ *
+ * RETURN
+ * res            A boolean equal to false if the callback stopped the
+ *                search, true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool kdtBallVisit(KdTree *kdt, Point *q, double r,
+                  bool visit(void *value, void *ctx), void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the positions of the provided KdTree that are included in a ball
+ * of radius r and centered at the position q. Nothing is allocated, and the
+ * subtrees entirely inside the ball are counted without being walked.
+ *
+ * PARAMETERS
+ * kdt            A valid pointer to a KdTree object
+ * q              The center of the ball
+ * r              The radius of the ball
+ *
+ * RETURN
+ * nb             The number of positions in the ball
+ * ------------------------------------------------------------------------- */
+
+size_t kdtBallCount(KdTree *kdt, Point *q, double r);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the k positions of the provided KdTree that are the closest to the
+ * position q and returns their values, sorted by increasing distance to q.
+ * Ties are broken arbitrarily.
+ *
+ * PARAMETERS
+ * kdt            A valid pointer to a KdTree object
+ * q              The query position
+ * k              The number of neighbours to look for
+ *
+ * RETURN
+ * l              A List containing the values of the min(k, size) nearest
+ *                positions, or NULL in case of allocation error.
+ *
+ * NOTES
+ * The List must be freed but not its content.
+ * ------------------------------------------------------------------------- */
+
+List *kdtKNearest(KdTree *kdt, Point *q, size_t k);
+
+#endif // !_KDTREE_H_
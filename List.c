@@ -6,6 +6,45 @@
 #include <stdlib.h>
 #include "List.h"
 
+// capacities of the first chunk and of the largest ones, each new chunk
+// being twice as large as the previous one
+#define LIST_MIN_CHUNK 16
+#define LIST_MAX_CHUNK 1024
+
+/* Prototypes of static functions */
+
+/* ------------------------------------------------------------------------- *
+ * Creates an empty chunk, twice as large as its neighbour (up to
+ * LIST_MAX_CHUNK).
+ *
+ * PARAMETERS
+ * prev         The chunk it will follow or precede, or NULL.
+ * atEnd        Whether the chunk is filled from its end (for insertions
+ *              at the beginning of the List) rather than from its start.
+ *
+ * RETURN
+ * c            A pointer to the chunk, or NULL in case of error.
+ * ------------------------------------------------------------------------- */
+static LChunk *lchunkNew(LChunk *prev, bool atEnd);
+
+/* Function definitions */
+
+LChunk *lchunkNew(LChunk *prev, bool atEnd)
+{
+    size_t capacity = LIST_MIN_CHUNK;
+    if (prev != NULL && prev->capacity < LIST_MAX_CHUNK)
+        capacity = 2 * prev->capacity;
+    else if (prev != NULL)
+        capacity = prev->capacity;
+    LChunk *c = malloc(sizeof(LChunk) + capacity * sizeof(void *));
+    if (!c)
+        return NULL;
+    c->next = NULL;
+    c->capacity = capacity;
+    c->start = c->end = atEnd ? capacity : 0;
+    return c;
+}
+
 List *listNew(void)
 {
     List *l = malloc(sizeof(List));
@@ -19,21 +58,31 @@ List *listNew(void)
 
 void listFree(List *l, bool freeContent)
 {
-    // Free LNodes
-    LNode *node = l->head;
-    LNode *prev = NULL;
-    while (node != NULL)
+    // Free LChunks
+    LChunk *chunk = l->head;
+    while (chunk != NULL)
     {
-        prev = node;
-        node = node->next;
+        LChunk *next = chunk->next;
         if (freeContent)
-            free(prev->value);
-        free(prev);
+            for (size_t i = chunk->start; i < chunk->end; i++)
+                free(chunk->values[i]);
+        free(chunk);
+        chunk = next;
     }
     // Free LinkedList sentinel
     free(l);
 }
 
+void listClear(List *l)
+{
+    // the spare chunks following the last one stay empty until
+    // listInsertLast() moves to them
+    for (LChunk *chunk = l->head; chunk != NULL; chunk = chunk->next)
+        chunk->start = chunk->end = 0;
+    l->last = l->head;
+    l->size = 0;
+}
+
 size_t listSize(List *l)
 {
     return l->size;
@@ -41,52 +90,65 @@ size_t listSize(List *l)
 
 bool listInsertLast(List *l, void *value)
 {
-    LNode *node = malloc(sizeof(LNode));
-    if (!node)
-        return false;
-    // Initialisation
-    node->next = NULL;
-    node->value = value;
-    // Adding the node to the list
-    if (!l->last)
+    if (l->last && l->last->end == l->last->capacity && l->last->next)
     {
-        // First element in the list
-        l->last = node;
-        l->head = node;
+        // No room left after the last element: reusing a spare chunk left
+        // by listClear()
+        l->last = l->last->next;
     }
-    else
+    else if (!l->last || l->last->end == l->last->capacity)
     {
-        // At least one element in the list
-        l->last->next = node;
-        l->last = node;
+        // No room left after the last element: adding a chunk
+        LChunk *chunk = lchunkNew(l->last, false);
+        if (!chunk)
+            return false;
+        if (!l->last)
+            l->head = chunk;
+        else
+            l->last->next = chunk;
+        l->last = chunk;
     }
-    // In both cases, increment size
+    l->last->values[l->last->end++] = value;
     l->size++;
     return true;
 }
 
 bool listInsertFirst(List *l, void *value)
 {
-    LNode *node = malloc(sizeof(LNode));
-    if (!node)
-        return false;
-    // Initialisation
-    node->next = NULL;
-    node->value = value;
-    // Adding the node to the list
-    if (!l->head)
+    if (!l->head || l->head->start == 0)
     {
-        // First element in the list
-        l->head = node;
-        l->last = node;
+        // No room left before the first element: adding a chunk, filled
+        // from its end
+        LChunk *chunk = lchunkNew(l->head, true);
+        if (!chunk)
+            return false;
+        chunk->next = l->head;
+        if (!l->head)
+            l->last = chunk;
+        l->head = chunk;
     }
-    else
+    l->head->values[--l->head->start] = value;
+    l->size++;
+    return true;
+}
+
+void listIterInit(ListIter *it, List *l)
+{
+    it->chunk = l->head;
+    it->index = l->head ? l->head->start : 0;
+}
+
+bool listIterNext(ListIter *it, void **value)
+{
+    // skipping the chunks read entirely, and the empty ones
+    while (it->chunk != NULL && it->index == it->chunk->end)
     {
-        // At least one element in the list
-        node->next = l->head;
-        l->head = node;
+        it->chunk = it->chunk->next;
+        if (it->chunk != NULL)
+            it->index = it->chunk->start;
     }
-    // In both cases, increment size
-    l->size++;
+    if (it->chunk == NULL)
+        return false;
+    *value = it->chunk->values[it->index++];
     return true;
 }
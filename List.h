@@ -1,7 +1,9 @@
 /* ========================================================================= *
  * List interface:
- * Note that the linked list structure is not opaque so that you can
- * manipulate it directly.
+ * An unrolled linked list: the values are stored by blocks in chunks of
+ * growing capacity, so that appending costs one allocation every few dozen
+ * elements. The structure is not opaque, but the elements should be read
+ * through a ListIter rather than by following the chunks directly.
  * ========================================================================= */
 
 #ifndef _LIST_H_
@@ -10,19 +12,28 @@
 #include <stddef.h>
 #include <stdbool.h>
 
-typedef struct lnode_t
+typedef struct lchunk_t
 {
-    void *value;
-    struct lnode_t *next;
-} LNode;
+    struct lchunk_t *next;
+    size_t capacity;
+    size_t start; // index of the first used slot
+    size_t end;   // index following the last used slot
+    void *values[];
+} LChunk;
 
 typedef struct list_t
 {
     size_t size;
-    LNode *head;
-    LNode *last;
+    LChunk *head;
+    LChunk *last;
 } List;
 
+typedef struct listiter_t
+{
+    LChunk *chunk;
+    size_t index;
+} ListIter;
+
 /* ------------------------------------------------------------------------- *
  * Creates an empty List
  *
@@ -46,6 +57,19 @@ List *listNew(void);
 
 void listFree(List *l, bool freeContent);
 
+/* ------------------------------------------------------------------------- *
+ * Removes all the elements of the given List, without freeing them. The
+ * chunks of the List are kept and reused by the next calls to
+ * listInsertLast(), so that a List that is cleared and refilled repeatedly
+ * stops allocating memory once it has reached its largest size.
+ *
+ * PARAMETERS
+ * l            A valid pointer to a List object
+ *
+ * ------------------------------------------------------------------------- */
+
+void listClear(List *l);
+
 /* ------------------------------------------------------------------------- *
  * Counts the number of elements stored in the given List.
  *
@@ -86,4 +110,29 @@ bool listInsertFirst(List *l, void *value);
 
 bool listInsertLast(List *l, void *value);
 
+/* ------------------------------------------------------------------------- *
+ * Initialises an iterator on the elements of the given List, from the first
+ * to the last one. The List must not be modified while it is iterated.
+ *
+ * PARAMETERS
+ * it           A valid pointer to a ListIter object
+ * l            A valid pointer to a List object
+ * ------------------------------------------------------------------------- */
+
+void listIterInit(ListIter *it, List *l);
+
+/* ------------------------------------------------------------------------- *
+ * Moves the iterator to the next element of its List.
+ *
+ * PARAMETERS
+ * it           A valid pointer to an initialised ListIter object
+ * value        Set to the value of the element
+ *
+ * RETURN
+ * res          A boolean equal to false if all the elements were already
+ *              iterated (value is then left unchanged), true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool listIterNext(ListIter *it, void **value);
+
 #endif // !_LIST_H_
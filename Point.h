@@ -7,6 +7,16 @@
 
 typedef struct Point_t Point;
 
+// the structure is public so that the accessors below can be inline
+// functions (Point.c holds their external definitions), and so that the
+// containers can embed the coordinates of their points in their nodes
+// (a Point is then copied rather than referenced)
+struct Point_t
+{
+    double x;
+    double y;
+};
+
 /* ------------------------------------------------------------------------- *
  * Creates a new point with (x,y) coordinates. The Point must later be deleted
  * by calling ptFree.
@@ -40,7 +50,10 @@ void ptFree(Point *p);
  * x           The x coordinate of p (a double).
  * ------------------------------------------------------------------------- */
 
-double ptGetx(Point *p);
+inline double ptGetx(Point *p)
+{
+    return p->x;
+}
 
 /* ------------------------------------------------------------------------- *
  * Returns the y coordinate of the point.
@@ -52,7 +65,10 @@ double ptGetx(Point *p);
  * y           The y coordinate of p (a double).
  * ------------------------------------------------------------------------- */
 
-double ptGety(Point *p);
+inline double ptGety(Point *p)
+{
+    return p->y;
+}
 
 /* ------------------------------------------------------------------------- *
  * Computes the square of the euclidean distance between two points.
@@ -65,7 +81,13 @@ double ptGety(Point *p);
  * d            The square of the Euclidean distance between p1 and p2.
  * ------------------------------------------------------------------------- */
 
-double ptSqrDistance(Point *p1, Point *p2);
+inline double ptSqrDistance(Point *p1, Point *p2)
+{
+    double dx = p1->x - p2->x;
+    double dy = p1->y - p2->y;
+
+    return dx * dx + dy * dy;
+}
 
 /* ------------------------------------------------------------------------- *
  * Compare two points. p1<p2 if ptGetx(p1)<ptGetx(p2) or if
@@ -80,7 +102,19 @@ double ptSqrDistance(Point *p1, Point *p2);
  * c            An integer equal to 0 if p1=p2, <0 if p1<p2 and >0 if p1>p2.
  * ------------------------------------------------------------------------- */
 
-int ptCompare(Point *p1, Point *p2);
+inline int ptCompare(Point *p1, Point *p2)
+{
+    if (p1->x < p2->x)
+        return -1;
+    else if (p1->x > p2->x)
+        return +1;
+    else if (p1->y < p2->y)
+        return -1;
+    else if (p1->y > p2->y)
+        return +1;
+    else
+        return 0;
+}
 
 /* ------------------------------------------------------------------------- *
  * Prints the (x,y) coordinates of the point on the standard output.
@@ -0,0 +1,79 @@
+/* ========================================================================= *
+ * PointDct definition (functions shared by all the implementations)
+ * ========================================================================= */
+
+#include "PointDct.h"
+#include "List.h"
+#include "Point.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- *
+ * Inserts a value at the end of a list (callback of pdctBallVisit used by
+ * pdctBallSearch).
+ *
+ * PARAMETERS
+ * value        The value to insert.
+ * l            A valid pointer to a list object.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool collect(void *value, void *l);
+
+bool collect(void *value, void *l)
+{
+    return listInsertLast(l, value);
+}
+
+List *pdctBallSearch(PointDct *pd, Point *p, double r)
+{
+    List *l = listNew();
+    if (l == NULL)
+        return NULL;
+    if (!pdctBallVisit(pd, p, r, collect, l))
+    {
+        listFree(l, false);
+        return NULL;
+    }
+    return l;
+}
+
+bool pdctBallSearchInto(PointDct *pd, Point *p, double r, List *out)
+{
+    listClear(out);
+    return pdctBallVisit(pd, p, r, collect, out);
+}
+
+bool pdctListsToArrays(List *lpoints, List *lvalues, Point ***points,
+                       void ***values, size_t *n)
+{
+    *n = listSize(lpoints) < listSize(lvalues) ? listSize(lpoints) : listSize(lvalues);
+    *points = NULL;
+    *values = NULL;
+    // malloc(0) may return NULL: an empty dictionary is not an error
+    if (*n == 0)
+        return true;
+    *points = malloc(*n * sizeof(Point *));
+    *values = malloc(*n * sizeof(void *));
+    if (*points == NULL || *values == NULL)
+    {
+        printf("pdctListsToArrays: allocation error\n");
+        free(*points);
+        free(*values);
+        *points = NULL;
+        *values = NULL;
+        return false;
+    }
+
+    size_t i = 0;
+    ListIter ip, iv;
+    listIterInit(&ip, lpoints);
+    listIterInit(&iv, lvalues);
+    void *p;
+    while (listIterNext(&ip, &p) && listIterNext(&iv, &(*values)[i]))
+        (*points)[i++] = p;
+    return true;
+}
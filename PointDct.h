@@ -5,6 +5,8 @@
 #ifndef _POINTDCT_H_
 #define _POINTDCT_H_
 
+#include <stddef.h>
+#include <stdbool.h>
 #include "List.h"
 #include "Point.h"
 
@@ -63,6 +65,61 @@ size_t pdctSize(PointDct *pd);
 
 void *pdctExactSearch(PointDct *pd, Point *p);
 
+/* ------------------------------------------------------------------------- *
+ * Looks for a batch of points at once, as n calls to pdctExactSearch would.
+ * The implementations sharing a tree traversal between the queries make it
+ * faster than searching them one by one on large batches.
+ *
+ * PARAMETERS
+ * pd           A valid pointer to a PointDct object
+ * points       An array of n points to look for
+ * n            The number of points
+ * values       An array of n pointers, the i-th one being set to one of the
+ *              values corresponding to points[i], or NULL if it is not
+ *              present in the PointDct
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error, true
+ *              otherwise
+ * ------------------------------------------------------------------------- */
+
+bool pdctExactSearchBatch(PointDct *pd, Point **points, size_t n, void **values);
+
+/* ------------------------------------------------------------------------- *
+ * Looks for a batch of points, as n calls to pdctExactSearch would. The
+ * tree implementations advance several searches at once and prefetch their
+ * next nodes, which hides the memory latency on dictionaries larger than
+ * the cache, without sorting nor allocating anything.
+ *
+ * PARAMETERS
+ * pd           A valid pointer to a PointDct object
+ * points       An array of n points to look for
+ * n            The number of points
+ * values       An array of n pointers, the i-th one being set to one of the
+ *              values corresponding to points[i], or NULL if it is not
+ *              present in the PointDct
+ * ------------------------------------------------------------------------- */
+
+void pdctExactSearchInterleaved(PointDct *pd, Point **points, size_t n, void **values);
+
+/* ------------------------------------------------------------------------- *
+ * Removes the element of position p and value value from the Point
+ * dictionary, so that it can be updated without being rebuilt. Neither p
+ * nor the value is freed.
+ *
+ * PARAMETERS
+ * pd           A valid pointer to a PointDct object
+ * p            The position of the element
+ * value        The value of the element (several elements may share the
+ *              same position)
+ *
+ * RETURN
+ * res          A boolean equal to true if the element was found and
+ *              removed, false otherwise
+ * ------------------------------------------------------------------------- */
+
+bool pdctRemove(PointDct *pd, Point *p, void *value);
+
 /* ------------------------------------------------------------------------- *
  * Finds the set of positions (x,y) in the Point dictionary that are included
  * in a ball of radius r and centered at the position q given as argument.
@@ -85,4 +142,105 @@ void *pdctExactSearch(PointDct *pd, Point *p);
 
 List *pdctBallSearch(PointDct *pd, Point *p, double r);
 
+/* ------------------------------------------------------------------------- *
+ * Same as pdctBallSearch(), but the values are stored in a List provided by
+ * the caller, which is cleared first. Reusing the same List for successive
+ * queries keeps its memory: once it is large enough, the queries do not
+ * allocate anything.
+ *
+ * PARAMETERS
+ * pd           A valid pointer to a PointDct object
+ * q            The center of the ball
+ * r            The radius of the ball
+ * out          A valid pointer to the List receiving the values
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error (out
+ *              then holds part of the values)
+ * ------------------------------------------------------------------------- */
+
+bool pdctBallSearchInto(PointDct *pd, Point *p, double r, List *out);
+
+/* ------------------------------------------------------------------------- *
+ * Passes the value of every position of the Point dictionary that is
+ * included in a ball of radius r and centered at the position q to a
+ * callback (in no particular order). No list is built: the search stops as
+ * soon as the callback returns false. pdctBallSearch() is built on it.
+ *
+ * PARAMETERS
+ * pd           A valid pointer to a PointDct object
+ * q            The center of the ball
+ * r            The radius of the ball
+ * visit        The callback, called as visit(value, ctx). It returns true
+ *              to continue the search, false to stop it
+ * ctx          A pointer passed unchanged to the callback
+ *
+ * RETURN
+ * res          A boolean equal to false if the callback stopped the search
+ *              (or in case of allocation error), true otherwise
+ * ------------------------------------------------------------------------- */
+
+bool pdctBallVisit(PointDct *pd, Point *q, double r,
+                   bool visit(void *value, void *ctx), void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the positions of the Point dictionary that are included in a ball
+ * of radius r and centered at the position q given as argument, without
+ * allocating anything.
+ *
+ * PARAMETERS
+ * pd           A valid pointer to a PointDct object
+ * q            The center of the ball
+ * r            The radius of the ball
+ *
+ * RETURN
+ * nb           The number of positions in the ball
+ * ------------------------------------------------------------------------- */
+
+size_t pdctBallCount(PointDct *pd, Point *q, double r);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the k positions in the Point dictionary that are the closest to the
+ * position q given as argument. The function returns a list of the values
+ * associated to these positions, sorted by increasing distance to q (ties
+ * are broken arbitrarily).
+ *
+ * PARAMETERS
+ * pd           A valid pointer to a PointDct object
+ * q            The query position
+ * k            The number of neighbours to look for
+ *
+ * RETURN
+ * l            A list containing the values of the min(k, pdctSize(pd))
+ *              nearest positions, or NULL in case of allocation error.
+ *
+ * NOTES
+ * The list must be freed but not its content.
+ * ------------------------------------------------------------------------- */
+
+List *pdctKNearest(PointDct *pd, Point *q, size_t k);
+
+/* ------------------------------------------------------------------------- *
+ * Copies the arguments of pdctCreate into two arrays, for the
+ * implementations building their structure in one pass. Only the first
+ * min(listSize(lpoints), listSize(lvalues)) elements are kept.
+ *
+ * PARAMETERS
+ * lpoints          A list of Point objects (Point pointers)
+ * lvalues          A list of values (void * pointers)
+ * points           Set to an array of the n points (NULL if n is 0)
+ * values           Set to an array of the n values (NULL if n is 0)
+ * n                Set to the number of elements
+ *
+ * RETURN
+ * res              A boolean equal to false in case of allocation error
+ *                  (nothing is then left allocated)
+ *
+ * NOTES
+ * Both arrays must be freed by the caller.
+ * ------------------------------------------------------------------------- */
+
+bool pdctListsToArrays(List *lpoints, List *lvalues, Point ***points,
+                       void ***values, size_t *n);
+
 #endif
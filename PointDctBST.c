@@ -5,162 +5,424 @@
 #include "PointDct.h"
 #include "List.h"
 #include "Point.h"
-#include "BST.h"
+#include "BSTTemplate.h"
+#include "Heap.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
+#include <float.h>
+
+// number of positions of a same abscissa that pdctBallCount tests one by
+// one before counting their whole column from the subtree sizes
+#define COLUMN_RUN 16
 
 /* Opaque Structure */
 
-typedef struct Value_t Value;
+typedef struct Position_t Position;
 
-struct Value_t
+// the keys of the tree: the coordinates are copied, so that comparing two
+// keys reads neither a Point nor a wrapper
+struct Position_t
 {
-    void *position;
-    void *value;
+    double x;
+    double y;
 };
 
-struct PointDct_t
+typedef struct BallFilter_t BallFilter;
+
+struct BallFilter_t
+{
+    double x;
+    double y;
+    double r2;
+    bool (*visit)(void *, void *);
+    void *ctx;
+};
+
+typedef struct BallCount_t BallCount;
+
+// state of pdctBallCount along the range of keys of a ball
+struct BallCount_t
+{
+    BallFilter filter; // center and squared radius of the ball
+    size_t count;
+    Position last; // last position visited
+    size_t run; // number of positions of abscissa last.x visited in a row
+    size_t runCount; // number of them in the ball
+};
+
+typedef struct KNearest_t KNearest;
+
+struct KNearest_t
 {
-    BST *bst;
+    Heap *heap;
+    size_t k;
+    double x;
+    double y;
 };
 
 /* ------------------------------------------------------------------------- *
- * Compares two values using ptCompare
+ * Compares two positions as ptCompare does (by x, then by y).
  *
  * PARAMETERS
- * a, b		The values to be compared
+ * a, b     The positions to be compared
  *
  * RETURN
  * res      The result of the comparison
  * ------------------------------------------------------------------------- */
-int compare_doubles(void* a, void* b);
+static inline int positionCompare(const Position *a, const Position *b);
+
+/* ------------------------------------------------------------------------- *
+ * Tests whether a position lies in the ball of a BallFilter, with the
+ * rounded squared distance.
+ *
+ * PARAMETERS
+ * filter       A valid pointer to a BallFilter object.
+ * px, py       The coordinates of the position.
+ *
+ * RETURN
+ * res          A boolean equal to true if the position is in the ball.
+ * ------------------------------------------------------------------------- */
+static inline bool inBall(const BallFilter *filter, double px, double py);
+
+BST_DEFINE(PointBST, Position, positionCompare)
+
+struct PointDct_t
+{
+    PointBST *bst;
+};
+
+/* ------------------------------------------------------------------------- *
+ * Callback of PointBSTRangeVisit that forwards the values whose position
+ * lies in the ball described by a BallFilter to the callback of the
+ * BallFilter.
+ *
+ * PARAMETERS
+ * key          The position of the element.
+ * value        The value of the element.
+ * ctx          A valid pointer to a BallFilter object.
+ *
+ * RETURN
+ * res          A boolean equal to false if the callback of the BallFilter
+ *              asks to stop the search, true otherwise.
+ * ------------------------------------------------------------------------- */
+static bool ballFilter(const Position *key, void *value, void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Callback of PointBSTVisit that offers a value to the bounded heap of a
+ * k-nearest neighbours search.
+ *
+ * PARAMETERS
+ * key          The position of the element.
+ * value        The value of the element.
+ * ctx          A valid pointer to a KNearest object.
+ *
+ * RETURN
+ * res          A boolean equal to false in case of allocation error.
+ * ------------------------------------------------------------------------- */
+static bool heapOffer(const Position *key, void *value, void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Computes the range of keys holding the positions of a ball: all those
+ * whose x is within r of the center. The bounds are widened by a few ulps,
+ * since the positions are then tested with the rounded squared distance,
+ * which accepts a point at a distance of exactly r whose x is rounded
+ * beyond x - r or x + r.
+ *
+ * PARAMETERS
+ * x            The x coordinate of the center of the ball.
+ * r            The radius of the ball.
+ * keymin       Set to the lower bound of the range.
+ * keymax       Set to the upper bound of the range.
+ *
+ * ------------------------------------------------------------------------- */
+static void ballRange(double x, double r, Position *keymin, Position *keymax);
+
+/* ------------------------------------------------------------------------- *
+ * Callback of PointBSTRangeVisit that counts the values whose position lies
+ * in the ball of a BallCount, and stops in a long column of positions of a
+ * same abscissa.
+ *
+ * PARAMETERS
+ * key          The position of the element.
+ * value        The value of the element (unused).
+ * ctx          A valid pointer to a BallCount object.
+ *
+ * RETURN
+ * res          A boolean equal to false once COLUMN_RUN positions of the
+ *              same abscissa were visited in a row, true otherwise.
+ * ------------------------------------------------------------------------- */
+static bool ballCount(const Position *key, void *value, void *ctx);
+
+/* ------------------------------------------------------------------------- *
+ * Finds the farthest ordinate from the center of a ball, on one side, at
+ * which a position of a given abscissa is still in the ball. The center of
+ * the ball must be in it at that abscissa.
+ *
+ * PARAMETERS
+ * filter       A valid pointer to a BallFilter object.
+ * px           The abscissa of the positions.
+ * step         The first distance tried, positive for the upper edge and
+ *              negative for the lower one.
+ *
+ * RETURN
+ * py           The ordinate of the edge of the ball (possibly infinite).
+ * ------------------------------------------------------------------------- */
+static double columnEdge(const BallFilter *filter, double px, double step);
+
+int positionCompare(const Position *a, const Position *b)
+{
+    if (a->x != b->x)
+        return (a->x < b->x) ? -1 : +1;
+    if (a->y != b->y)
+        return (a->y < b->y) ? -1 : +1;
+    return 0;
+}
+
+bool inBall(const BallFilter *filter, double px, double py)
+{
+    double dx = px - filter->x;
+    double dy = py - filter->y;
+    return dx * dx + dy * dy <= filter->r2;
+}
 
 PointDct *pdctCreate(List *lpoints, List *lvalues)
 {
     PointDct *pd = malloc(sizeof(PointDct));
-    BST *bst = bstNew(&compare_doubles);
-    if (pd == NULL || bst == NULL)
+    Point **points;
+    void **values;
+    size_t n;
+    if (pd == NULL || !pdctListsToArrays(lpoints, lvalues, &points, &values, &n))
+    {
+        printf("pdctCreate: allocation error\n");
+        free(pd);
+        return NULL;
+    }
+    Position *keys = malloc(n * sizeof(Position));
+    if (n > 0 && keys == NULL)
     {
         printf("pdctCreate: allocation error\n");
+        free(pd);
+        free(points);
+        free(values);
         return NULL;
     }
-    bool error = false;
-    LNode *pp = lpoints->head, *pv = lvalues->head;
-    while (pp != NULL && pv != NULL)
+
+    // the whole batch is known: the tree is built in one pass
+    for (size_t i = 0; i < n; i++)
     {
-        Value *value = malloc(sizeof(Value));
-        value->value = pv->value;
-        value->position = pp->value;
-        error = error || !bstInsert(bst, pp->value, value);
-        pp = pp->next;
-        pv = pv->next;
+        keys[i].x = ptGetx(points[i]);
+        keys[i].y = ptGety(points[i]);
     }
-    if (error) 
+    free(points);
+    pd->bst = PointBSTBuildFromArrays(keys, values, n);
+    free(keys);
+    free(values);
+    if (pd->bst == NULL)
     {
-        pdctFree(pd);
+        printf("pdctCreate: allocation error\n");
+        free(pd);
         return NULL;
     }
-    pd->bst = bst;
+    // pd is only searched until a removal thaws it (a failure leaves the
+    // tree as it is, searches are then slower but still correct)
+    PointBSTFreeze(pd->bst);
     return pd;
 }
 
-int compare_doubles(void* a, void* b)
-{
-    return ptCompare((Point*) a, (Point*) b);
-}
-
 void pdctFree(PointDct *pd)
 {
-    bstFree(pd->bst, false, true);
+    PointBSTFree(pd->bst);
     free(pd);
 }
 
 size_t pdctSize(PointDct *pd)
 {
-    return bstSize(pd->bst);
+    return PointBSTSize(pd->bst);
 }
 
 void *pdctExactSearch(PointDct *pd, Point *p)
 {
-    void *val = bstSearch(pd->bst, p);
-    if (val == NULL)
-        return NULL;
-    return ((Value*) val)->value;
+    Position key = {ptGetx(p), ptGety(p)};
+    return PointBSTSearch(pd->bst, &key);
 }
 
-List *pdctBallSearch(PointDct *pd, Point *p, double r)
+bool pdctExactSearchBatch(PointDct *pd, Point **points, size_t n, void **values)
 {
-    // first filtrage of the keys with the fonction bstRangeSearch
-    Point *keymin = ptNew(ptGetx(p) - r, ptGety(p) - r);
-    if (keymin == NULL)
-        return NULL;
-    Point *keymax = ptNew(ptGetx(p) + r, ptGety(p) + r);
-    if (keymax == NULL)
+    Position *keys = malloc(n * sizeof(Position));
+    if (n > 0 && keys == NULL)
     {
-        ptFree(keymin);
-        return NULL;
+        printf("pdctExactSearchBatch: allocation error\n");
+        return false;
     }
-    List *list = bstRangeSearch(pd->bst, keymin, keymax);
-    if (list == NULL)
-        return NULL;
-    ptFree(keymin);
-    ptFree(keymax);
+    for (size_t i = 0; i < n; i++)
+    {
+        keys[i].x = ptGetx(points[i]);
+        keys[i].y = ptGety(points[i]);
+    }
+    bool res = PointBSTSearchBatch(pd->bst, keys, n, values);
+    free(keys);
+    return res;
+}
 
-    // erasing of the points outside the ball
-    r = r * r;
-    bool error = false;
-    LNode *prev = NULL;
-    for (LNode *n = list->head; n != NULL; )
+void pdctExactSearchInterleaved(PointDct *pd, Point **points, size_t n, void **values)
+{
+    // the keys are copied by groups of the size of those of the search
+    Position keys[BST_LANES];
+    for (size_t base = 0; base < n; base += BST_LANES)
     {
-        if (!(ptSqrDistance(((Value *)n->value)->position, p) <= r))
+        size_t m = (n - base < BST_LANES) ? n - base : BST_LANES;
+        for (size_t i = 0; i < m; i++)
         {
-            //suppress n of the liste
-            // if n = head and n = tail
-            if (prev == NULL && n->next == NULL)
-            {
-                list->head = NULL;
-                list->last = NULL;
-                free(n);
-                n = NULL;
-            }
-            // if n = head and n != tail
-            else if (prev == NULL)
-            {
-                list->head = n->next;
-                free(n);
-                n = list->head;
-            }
-            // if n = tail and prev != NULL
-            else if(n->next == NULL)
-            {
-                list->last = prev;
-                prev->next = NULL;
-                free(n);
-                n = NULL;
-            }
-            else
-            {
-                prev->next = n->next;
-                free(n);
-                n = prev->next;
-            }
-
-            // if here, size is at least of 1, so ok
-            list->size--;
+            keys[i].x = ptGetx(points[base + i]);
+            keys[i].y = ptGety(points[base + i]);
         }
+        PointBSTSearchInterleaved(pd->bst, keys, m, values + base);
+    }
+}
+
+bool pdctRemove(PointDct *pd, Point *p, void *value)
+{
+    Position key = {ptGetx(p), ptGety(p)};
+    return PointBSTRemove(pd->bst, &key, value);
+}
+
+bool ballFilter(const Position *key, void *value, void *ctx)
+{
+    BallFilter *filter = ctx;
+    // erasing of the points outside the ball
+    if (!inBall(filter, key->x, key->y))
+        return true;
+    return filter->visit(value, filter->ctx);
+}
+
+void ballRange(double x, double r, Position *keymin, Position *keymax)
+{
+    double margin = 4 * DBL_EPSILON * (fabs(x) + r);
+    keymin->x = (x - r) - margin;
+    keymin->y = -INFINITY;
+    keymax->x = (x + r) + margin;
+    keymax->y = INFINITY;
+}
+
+bool pdctBallVisit(PointDct *pd, Point *q, double r,
+                   bool visit(void *value, void *ctx), void *ctx)
+{
+    // first filtrage of the keys with the x coordinates of the ball
+    double x = ptGetx(q), y = ptGety(q);
+    Position keymin, keymax;
+    ballRange(x, r, &keymin, &keymax);
+    BallFilter filter = {x, y, r * r, visit, ctx};
+    return PointBSTRangeVisit(pd->bst, &keymin, &keymax, ballFilter, &filter);
+}
+
+bool ballCount(const Position *key, void *value, void *ctx)
+{
+    (void)value;
+    BallCount *bc = ctx;
+    if (bc->run == 0 || key->x != bc->last.x)
+    {
+        bc->run = 0;
+        bc->runCount = 0;
+    }
+    bc->run++;
+    bc->last = *key;
+    if (inBall(&bc->filter, key->x, key->y))
+    {
+        bc->count++;
+        bc->runCount++;
+    }
+    return bc->run < COLUMN_RUN;
+}
+
+double columnEdge(const BallFilter *filter, double px, double step)
+{
+    // inside stays in the ball and outside out of it: the step is doubled
+    // until it leaves the ball, then both are brought together by
+    // bisection, the rounded distance growing with |py - y| along the
+    // column
+    double inside = filter->y;
+    double outside = filter->y + step;
+    while (!isinf(outside) && inBall(filter, px, outside))
+    {
+        inside = outside;
+        step *= 2;
+        outside = filter->y + step;
+    }
+    if (isinf(outside))
+    {
+        if (inBall(filter, px, outside))
+            return outside;
+        outside = copysign(DBL_MAX, step);
+        if (inBall(filter, px, outside))
+            return outside;
+    }
+    for (;;)
+    {
+        double mid = inside / 2 + outside / 2;
+        if (mid == inside || mid == outside)
+            return inside;
+        if (inBall(filter, px, mid))
+            inside = mid;
         else
+            outside = mid;
+    }
+}
+
+size_t pdctBallCount(PointDct *pd, Point *q, double r)
+{
+    // the ball is not a range of the lexicographic order: the candidates of
+    // the range are tested one by one, except in the long columns of
+    // positions of a same abscissa, whose part in the ball is a range
+    double x = ptGetx(q), y = ptGety(q);
+    Position keymin, keymax;
+    ballRange(x, r, &keymin, &keymax);
+    BallCount bc = {{x, y, r * r, NULL, NULL}, 0, {0, 0}, 0, 0};
+    while (!PointBSTRangeVisit(pd->bst, &keymin, &keymax, ballCount, &bc))
+    {
+        // the visit stopped in the column of bc.last: the whole column is
+        // counted at once instead of the positions visited in it, and the
+        // visit resumes after it
+        double cx = bc.last.x;
+        bc.count -= bc.runCount;
+        if (inBall(&bc.filter, cx, y))
         {
-            // get the field value of "Value"
-            n->value = ((Value *) n->value)->value;
-            prev = n;
-            n = n->next;
+            double step = (r > DBL_MIN) ? r : DBL_MIN;
+            Position lo = {cx, columnEdge(&bc.filter, cx, -step)};
+            Position hi = {cx, columnEdge(&bc.filter, cx, step)};
+            bc.count += PointBSTRangeCount(pd->bst, &lo, &hi);
         }
+        if (cx == INFINITY)
+            break;
+        keymin.x = nextafter(cx, INFINITY);
+        keymin.y = -INFINITY;
+        bc.run = 0;
     }
-    if (error) 
-    {
-        listFree(list, false);
+    return bc.count;
+}
+
+bool heapOffer(const Position *key, void *value, void *ctx)
+{
+    KNearest *knn = ctx;
+    double dx = key->x - knn->x;
+    double dy = key->y - knn->y;
+    return heapOfferBounded(knn->heap, knn->k, dx * dx + dy * dy, value);
+}
+
+List *pdctKNearest(PointDct *pd, Point *q, size_t k)
+{
+    // the lexicographic order gives no bound on the distance to q: every
+    // position is a candidate, so the whole array is scanned. No more than
+    // the stored positions can be returned: the heap is sized for them
+    if (k > PointBSTSize(pd->bst))
+        k = PointBSTSize(pd->bst);
+    KNearest knn = {heapNew(k), k, ptGetx(q), ptGety(q)};
+    if (knn.heap == NULL)
         return NULL;
-    }
-    return list;
+    List *l = NULL;
+    if (PointBSTVisit(pd->bst, heapOffer, &knn))
+        l = heapToSortedList(knn.heap);
+    heapFree(knn.heap);
+    return l;
 }
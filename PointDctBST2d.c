@@ -18,26 +18,26 @@ struct PointDct_t
 PointDct *pdctCreate(List *lpoints, List *lvalues)
 {
     PointDct *pd = malloc(sizeof(PointDct));
-    BST2d *bst2d = bst2dNew();
-    if (pd == NULL || bst2d == NULL)
+    Point **points;
+    void **values;
+    size_t n;
+    if (pd == NULL || !pdctListsToArrays(lpoints, lvalues, &points, &values, &n))
     {
         printf("pdctCreate: allocation error\n");
+        free(pd);
         return NULL;
     }
-    bool error = false;
-    LNode *pp = lpoints->head, *pv = lvalues->head;
-    while (pp != NULL && pv != NULL)
-    {
-        error = error || !bst2dInsert(bst2d, pp->value, pv->value);
-        pp = pp->next;
-        pv = pv->next;
-    }
-    if (error) 
+
+    // the whole point list is known: build a median-split tree in one pass
+    pd->bst2d = bst2dBuildFromArrays(points, values, n);
+    free(points);
+    free(values);
+    if (pd->bst2d == NULL)
     {
-        pdctFree(pd);
+        printf("pdctCreate: allocation error\n");
+        free(pd);
         return NULL;
     }
-    pd->bst2d = bst2d;
     return pd;
 }
 
@@ -57,7 +57,33 @@ void *pdctExactSearch(PointDct *pd, Point *p)
     return bst2dSearch(pd->bst2d, p);
 }
 
-List *pdctBallSearch(PointDct *pd, Point *p, double r)
+bool pdctExactSearchBatch(PointDct *pd, Point **points, size_t n, void **values)
+{
+    return bst2dSearchBatch(pd->bst2d, points, n, values);
+}
+
+void pdctExactSearchInterleaved(PointDct *pd, Point **points, size_t n, void **values)
+{
+    bst2dSearchInterleaved(pd->bst2d, points, n, values);
+}
+
+bool pdctRemove(PointDct *pd, Point *p, void *value)
+{
+    return bst2dRemove(pd->bst2d, p, value);
+}
+
+bool pdctBallVisit(PointDct *pd, Point *q, double r,
+                   bool visit(void *value, void *ctx), void *ctx)
+{
+    return bst2dBallVisit(pd->bst2d, q, r, visit, ctx);
+}
+
+size_t pdctBallCount(PointDct *pd, Point *q, double r)
+{
+    return bst2dBallCount(pd->bst2d, q, r);
+}
+
+List *pdctKNearest(PointDct *pd, Point *q, size_t k)
 {
-    return bst2dBallSearch(pd->bst2d, p, r);
+    return bst2dKNearest(pd->bst2d, q, k);
 }
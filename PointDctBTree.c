@@ -0,0 +1,94 @@
+/* ========================================================================= *
+ * PointDct definition (with BTree, a B+-tree with inline coordinates)
+ * ========================================================================= */
+
+#include "PointDct.h"
+#include "List.h"
+#include "Point.h"
+#include "BTree.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+struct PointDct_t
+{
+    BTree *bt;
+};
+
+PointDct *pdctCreate(List *lpoints, List *lvalues)
+{
+    PointDct *pd = malloc(sizeof(PointDct));
+    Point **points;
+    void **values;
+    size_t n;
+    if (pd == NULL || !pdctListsToArrays(lpoints, lvalues, &points, &values, &n))
+    {
+        printf("pdctCreate: allocation error\n");
+        free(pd);
+        return NULL;
+    }
+
+    // the whole point list is known: build the tree in one pass
+    pd->bt = btBuildFromArrays(points, values, n);
+    free(points);
+    free(values);
+    if (pd->bt == NULL)
+    {
+        printf("pdctCreate: allocation error\n");
+        free(pd);
+        return NULL;
+    }
+    return pd;
+}
+
+void pdctFree(PointDct *pd)
+{
+    btFree(pd->bt, false);
+    free(pd);
+}
+
+size_t pdctSize(PointDct *pd)
+{
+    return btSize(pd->bt);
+}
+
+void *pdctExactSearch(PointDct *pd, Point *p)
+{
+    return btSearch(pd->bt, p);
+}
+
+bool pdctExactSearchBatch(PointDct *pd, Point **points, size_t n, void **values)
+{
+    // the wide nodes keep the tree shallow: the queries are simply
+    // searched one by one
+    for (size_t i = 0; i < n; i++)
+        values[i] = btSearch(pd->bt, points[i]);
+    return true;
+}
+
+void pdctExactSearchInterleaved(PointDct *pd, Point **points, size_t n, void **values)
+{
+    for (size_t i = 0; i < n; i++)
+        values[i] = btSearch(pd->bt, points[i]);
+}
+
+bool pdctRemove(PointDct *pd, Point *p, void *value)
+{
+    return btRemove(pd->bt, p, value);
+}
+
+bool pdctBallVisit(PointDct *pd, Point *q, double r,
+                   bool visit(void *value, void *ctx), void *ctx)
+{
+    return btBallVisit(pd->bt, q, r, visit, ctx);
+}
+
+size_t pdctBallCount(PointDct *pd, Point *q, double r)
+{
+    return btBallCount(pd->bt, q, r);
+}
+
+List *pdctKNearest(PointDct *pd, Point *q, size_t k)
+{
+    return btKNearest(pd->bt, q, k);
+}
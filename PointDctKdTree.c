@@ -0,0 +1,94 @@
+/* ========================================================================= *
+ * PointDct definition (with KdTree, a kd-tree with bucketed leaves)
+ * ========================================================================= */
+
+#include "PointDct.h"
+#include "List.h"
+#include "Point.h"
+#include "KdTree.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+struct PointDct_t
+{
+    KdTree *kdt;
+};
+
+PointDct *pdctCreate(List *lpoints, List *lvalues)
+{
+    PointDct *pd = malloc(sizeof(PointDct));
+    Point **points;
+    void **values;
+    size_t n;
+    if (pd == NULL || !pdctListsToArrays(lpoints, lvalues, &points, &values, &n))
+    {
+        printf("pdctCreate: allocation error\n");
+        free(pd);
+        return NULL;
+    }
+
+    // the whole point list is known: build the tree in one pass
+    pd->kdt = kdtBuildFromArrays(points, values, n);
+    free(points);
+    free(values);
+    if (pd->kdt == NULL)
+    {
+        printf("pdctCreate: allocation error\n");
+        free(pd);
+        return NULL;
+    }
+    return pd;
+}
+
+void pdctFree(PointDct *pd)
+{
+    kdtFree(pd->kdt, false);
+    free(pd);
+}
+
+size_t pdctSize(PointDct *pd)
+{
+    return kdtSize(pd->kdt);
+}
+
+void *pdctExactSearch(PointDct *pd, Point *p)
+{
+    return kdtSearch(pd->kdt, p);
+}
+
+bool pdctExactSearchBatch(PointDct *pd, Point **points, size_t n, void **values)
+{
+    // the buckets of the leaves keep the tree shallow: the queries are
+    // simply searched one by one
+    for (size_t i = 0; i < n; i++)
+        values[i] = kdtSearch(pd->kdt, points[i]);
+    return true;
+}
+
+void pdctExactSearchInterleaved(PointDct *pd, Point **points, size_t n, void **values)
+{
+    for (size_t i = 0; i < n; i++)
+        values[i] = kdtSearch(pd->kdt, points[i]);
+}
+
+bool pdctRemove(PointDct *pd, Point *p, void *value)
+{
+    return kdtRemove(pd->kdt, p, value);
+}
+
+bool pdctBallVisit(PointDct *pd, Point *q, double r,
+                   bool visit(void *value, void *ctx), void *ctx)
+{
+    return kdtBallVisit(pd->kdt, q, r, visit, ctx);
+}
+
+size_t pdctBallCount(PointDct *pd, Point *q, double r)
+{
+    return kdtBallCount(pd->kdt, q, r);
+}
+
+List *pdctKNearest(PointDct *pd, Point *q, size_t k)
+{
+    return kdtKNearest(pd->kdt, q, k);
+}
@@ -5,70 +5,165 @@
 #include "PointDct.h"
 #include "List.h"
 #include "Point.h"
+#include "Heap.h"
+#include "Scan.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 
+// Number of positions filtered by each call to scanBall
+#define SCAN_BLOCK 256
+
+/* Opaque Structure */
+
+// The positions are copied in contiguous arrays (structure of arrays) so
+// that searches are flat scans instead of walks through the lists.
 struct PointDct_t
 {
-    List *lpoints;
-    List *lvalues;
+    size_t size;
+    double *x;
+    double *y;
+    void **values;
 };
 
 PointDct *pdctCreate(List *lpoints, List *lvalues)
 {
     PointDct *pd = malloc(sizeof(PointDct));
-    if (pd == NULL)
+    Point **points;
+    void **values;
+    size_t n;
+    if (pd == NULL || !pdctListsToArrays(lpoints, lvalues, &points, &values, &n))
+    {
+        printf("pdctCreate: allocation error\n");
+        free(pd);
+        return NULL;
+    }
+    double *x = malloc(n * sizeof(double));
+    double *y = malloc(n * sizeof(double));
+    if (n > 0 && (x == NULL || y == NULL))
     {
         printf("pdctCreate: allocation error\n");
+        free(pd);
+        free(points);
+        free(values);
+        free(x);
+        free(y);
         return NULL;
     }
-    pd->lpoints = lpoints;
-    pd->lvalues = lvalues;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = ptGetx(points[i]);
+        y[i] = ptGety(points[i]);
+    }
+    free(points);
+    pd->size = n;
+    pd->x = x;
+    pd->y = y;
+    pd->values = values;
     return pd;
 }
 
 void pdctFree(PointDct *pd)
 {
+    free(pd->x);
+    free(pd->y);
+    free(pd->values);
     free(pd);
 }
 
 size_t pdctSize(PointDct *pd)
 {
-    return listSize(pd->lpoints);
+    return pd->size;
 }
 
 void *pdctExactSearch(PointDct *pd, Point *p)
 {
-    for (LNode *pp = pd->lpoints->head, *pv = pd->lvalues->head; pp != NULL; pp = pp->next, pv = pv->next)
+    double x = ptGetx(p), y = ptGety(p);
+    for (size_t i = 0; i < pd->size; i++)
     {
-        if (ptCompare(pp->value, p) == 0)
+        if (pd->x[i] == x && pd->y[i] == y)
         {
-            return pv->value;
+            return pd->values[i];
         }
     }
     return NULL;
 }
 
-List *pdctBallSearch(PointDct *pd, Point *p, double radius)
+bool pdctExactSearchBatch(PointDct *pd, Point **points, size_t n, void **values)
 {
-    List *l = listNew();
-    if (l == NULL)
-        return NULL;
+    for (size_t i = 0; i < n; i++)
+        values[i] = pdctExactSearch(pd, points[i]);
+    return true;
+}
 
-    radius = radius * radius;
-    bool error = false;
-    for (LNode *pp = pd->lpoints->head, *pv = pd->lvalues->head; pp != NULL; pp = pp->next, pv = pv->next)
+void pdctExactSearchInterleaved(PointDct *pd, Point **points, size_t n, void **values)
+{
+    for (size_t i = 0; i < n; i++)
+        values[i] = pdctExactSearch(pd, points[i]);
+}
+
+bool pdctRemove(PointDct *pd, Point *p, void *value)
+{
+    double x = ptGetx(p), y = ptGety(p);
+    for (size_t i = 0; i < pd->size; i++)
     {
-        if (ptSqrDistance(pp->value, p) <= radius)
+        if (pd->x[i] == x && pd->y[i] == y && pd->values[i] == value)
         {
-            error = error || !listInsertLast(l, pv->value);
+            // the last position takes the place of the removed one
+            pd->size--;
+            pd->x[i] = pd->x[pd->size];
+            pd->y[i] = pd->y[pd->size];
+            pd->values[i] = pd->values[pd->size];
+            return true;
         }
     }
-    if (error) 
+    return false;
+}
+
+bool pdctBallVisit(PointDct *pd, Point *q, double r,
+                   bool visit(void *value, void *ctx), void *ctx)
+{
+    double x = ptGetx(q), y = ptGety(q);
+    double r2 = r * r;
+    size_t indices[SCAN_BLOCK];
+    for (size_t start = 0; start < pd->size; start += SCAN_BLOCK)
     {
-        listFree(l, false);
+        size_t len = (pd->size - start < SCAN_BLOCK) ? pd->size - start : SCAN_BLOCK;
+        size_t found = scanBall(pd->x + start, pd->y + start, len, x, y, r2, indices);
+        for (size_t i = 0; i < found; i++)
+        {
+            if (!visit(pd->values[start + indices[i]], ctx))
+                return false;
+        }
+    }
+    return true;
+}
+
+size_t pdctBallCount(PointDct *pd, Point *q, double r)
+{
+    return scanBallCount(pd->x, pd->y, pd->size, ptGetx(q), ptGety(q), r * r);
+}
+
+List *pdctKNearest(PointDct *pd, Point *q, size_t k)
+{
+    // no more than the stored positions can be returned: the heap is sized
+    // for them, whatever k is
+    if (k > pd->size)
+        k = pd->size;
+    Heap *heap = heapNew(k);
+    if (heap == NULL)
         return NULL;
+
+    double x = ptGetx(q), y = ptGety(q);
+    bool error = false;
+    for (size_t i = 0; i < pd->size && !error; i++)
+    {
+        double dx = pd->x[i] - x;
+        double dy = pd->y[i] - y;
+        error = !heapOfferBounded(heap, k, dx * dx + dy * dy, pd->values[i]);
     }
+    List *l = error ? NULL : heapToSortedList(heap);
+    heapFree(heap);
     return l;
 }
@@ -0,0 +1,110 @@
+/* ========================================================================= *
+ * Scan definition
+ * ========================================================================= */
+
+#include <stddef.h>
+
+#include "Scan.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+size_t scanBall(const double *x, const double *y, size_t n, double qx,
+                double qy, double sqrRadius, size_t *indices)
+{
+    // The indices are written unconditionally and the count only moves
+    // forward for the positions in the ball: the loops are branch-free
+    // and never write past indices[n - 1].
+    size_t count = 0;
+    size_t i = 0;
+
+#if defined(__AVX__)
+    __m256d vqx = _mm256_set1_pd(qx);
+    __m256d vqy = _mm256_set1_pd(qy);
+    __m256d vr2 = _mm256_set1_pd(sqrRadius);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), vqx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), vqy);
+        __m256d d = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(d, vr2, _CMP_LE_OQ));
+        indices[count] = i;
+        count += mask & 1;
+        indices[count] = i + 1;
+        count += (mask >> 1) & 1;
+        indices[count] = i + 2;
+        count += (mask >> 2) & 1;
+        indices[count] = i + 3;
+        count += (mask >> 3) & 1;
+    }
+#elif defined(__SSE2__)
+    __m128d vqx = _mm_set1_pd(qx);
+    __m128d vqy = _mm_set1_pd(qy);
+    __m128d vr2 = _mm_set1_pd(sqrRadius);
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), vqx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), vqy);
+        __m128d d = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        int mask = _mm_movemask_pd(_mm_cmple_pd(d, vr2));
+        indices[count] = i;
+        count += mask & 1;
+        indices[count] = i + 1;
+        count += (mask >> 1) & 1;
+    }
+#endif
+
+    // scalar code for the remaining positions (or all of them)
+    for (; i < n; i++)
+    {
+        double dx = x[i] - qx;
+        double dy = y[i] - qy;
+        indices[count] = i;
+        count += (dx * dx + dy * dy <= sqrRadius);
+    }
+    return count;
+}
+
+size_t scanBallCount(const double *x, const double *y, size_t n, double qx,
+                     double qy, double sqrRadius)
+{
+    size_t count = 0;
+    size_t i = 0;
+
+#if defined(__AVX__)
+    __m256d vqx = _mm256_set1_pd(qx);
+    __m256d vqy = _mm256_set1_pd(qy);
+    __m256d vr2 = _mm256_set1_pd(sqrRadius);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), vqx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), vqy);
+        __m256d d = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(d, vr2, _CMP_LE_OQ));
+        count += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+    }
+#elif defined(__SSE2__)
+    __m128d vqx = _mm_set1_pd(qx);
+    __m128d vqy = _mm_set1_pd(qy);
+    __m128d vr2 = _mm_set1_pd(sqrRadius);
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), vqx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), vqy);
+        __m128d d = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        int mask = _mm_movemask_pd(_mm_cmple_pd(d, vr2));
+        count += (mask & 1) + ((mask >> 1) & 1);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        double dx = x[i] - qx;
+        double dy = y[i] - qy;
+        count += (dx * dx + dy * dy <= sqrRadius);
+    }
+    return count;
+}
@@ -0,0 +1,53 @@
+/* ========================================================================= *
+ * Scan interface:
+ * Distance filtering of positions stored as a structure of arrays (one
+ * array for the x coordinates, one for the y coordinates). The kernels are
+ * vectorized with AVX or SSE2 when the compiler enables them, and fall
+ * back to scalar code otherwise.
+ * ========================================================================= */
+
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- *
+ * Finds the positions (x[i], y[i]) that are included in a ball of center
+ * (qx, qy) and returns their indices, in increasing order. The test is the
+ * same as ptSqrDistance(p, q) <= sqrRadius.
+ *
+ * PARAMETERS
+ * x            An array of n x coordinates
+ * y            An array of n y coordinates
+ * n            The number of positions
+ * qx, qy       The center of the ball
+ * sqrRadius    The square of the radius of the ball
+ * indices      An array of (at least) n elements where the indices of the
+ *              positions in the ball are written
+ *
+ * RETURN
+ * nb           The number of positions in the ball
+ * ------------------------------------------------------------------------- */
+
+size_t scanBall(const double *x, const double *y, size_t n, double qx,
+                double qy, double sqrRadius, size_t *indices);
+
+/* ------------------------------------------------------------------------- *
+ * Counts the positions (x[i], y[i]) that are included in a ball of center
+ * (qx, qy), with the same test as scanBall().
+ *
+ * PARAMETERS
+ * x            An array of n x coordinates
+ * y            An array of n y coordinates
+ * n            The number of positions
+ * qx, qy       The center of the ball
+ * sqrRadius    The square of the radius of the ball
+ *
+ * RETURN
+ * nb           The number of positions in the ball
+ * ------------------------------------------------------------------------- */
+
+size_t scanBallCount(const double *x, const double *y, size_t n, double qx,
+                     double qy, double sqrRadius);
+
+#endif // !_SCAN_H_
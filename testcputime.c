@@ -7,6 +7,7 @@
 #include <time.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "PointDct.h"
 #include "List.h"
@@ -15,6 +16,9 @@
 #define N 1000
 #define NSEARCH 1000
 #define RADIUS 0.1
+#define K 10
+// number of queries checked against a scan of all the points
+#define NCHECK 10
 
 typedef struct Data_t Data;
 
@@ -23,6 +27,157 @@ struct Data_t
     Point *point;
 };
 
+/* ------------------------------------------------------------------------- *
+ * Counts the points inside a ball by scanning all of them.
+ *
+ * PARAMETERS
+ * points       The points.
+ * removed      Whether each point was removed from the dictionary.
+ * n            The number of points.
+ * q            The center of the ball.
+ * r            The radius of the ball.
+ *
+ * RETURN
+ * nb           The number of points not removed at a distance <= r of q.
+ * ------------------------------------------------------------------------- */
+static size_t scanBallCount(Point **points, bool *removed, size_t n, Point *q,
+                            double r);
+
+/* ------------------------------------------------------------------------- *
+ * Checks the result of a k nearest neighbours search against the sorted
+ * distances of all the points.
+ *
+ * PARAMETERS
+ * l            The values returned by pdctKNearest.
+ * points       The points.
+ * removed      Whether each point was removed from the dictionary.
+ * n            The number of points.
+ * q            The query position.
+ * k            The number of neighbours looked for.
+ *
+ * RETURN
+ * res          A boolean equal to true if l holds min(k, number of points)
+ *              values whose distances to q are the smallest ones, in
+ *              increasing order.
+ * ------------------------------------------------------------------------- */
+static bool checkKNearest(List *l, Point **points, bool *removed, size_t n,
+                          Point *q, size_t k);
+
+/* ------------------------------------------------------------------------- *
+ * Compares two doubles (callback of qsort).
+ *
+ * PARAMETERS
+ * a, b         Valid pointers to doubles.
+ *
+ * RETURN
+ * nb           A negative, zero or positive number if *a is lower, equal or
+ *              greater than *b.
+ * ------------------------------------------------------------------------- */
+static int compareDouble(const void *a, const void *b);
+
+/* ------------------------------------------------------------------------- *
+ * Checks that two lists hold the same values, in any order.
+ *
+ * PARAMETERS
+ * a, b         The lists to compare (NULL is never equal to a list).
+ *
+ * RETURN
+ * res          A boolean equal to true if a and b have the same size and
+ *              each value appears as many times in both.
+ * ------------------------------------------------------------------------- */
+static bool sameValues(List *a, List *b);
+
+/* ------------------------------------------------------------------------- *
+ * Compares two pointers by address (callback of qsort).
+ *
+ * PARAMETERS
+ * a, b         Valid pointers to pointers.
+ *
+ * RETURN
+ * nb           A negative, zero or positive number if *a is lower, equal or
+ *              greater than *b.
+ * ------------------------------------------------------------------------- */
+static int comparePointer(const void *a, const void *b);
+
+size_t scanBallCount(Point **points, bool *removed, size_t n, Point *q,
+                     double r)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!removed[i] && ptSqrDistance(points[i], q) <= r * r)
+            count++;
+    }
+    return count;
+}
+
+bool checkKNearest(List *l, Point **points, bool *removed, size_t n,
+                   Point *q, size_t k)
+{
+    double *dists = malloc(n * sizeof(double));
+    if (l == NULL || (n > 0 && dists == NULL))
+    {
+        free(dists);
+        return false;
+    }
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!removed[i])
+            dists[m++] = ptSqrDistance(points[i], q);
+    }
+    qsort(dists, m, sizeof(double), compareDouble);
+
+    bool ok = listSize(l) == ((k < m) ? k : m);
+    ListIter it;
+    void *value;
+    listIterInit(&it, l);
+    for (size_t i = 0; ok && listIterNext(&it, &value); i++)
+        ok = ptSqrDistance(((Data *)value)->point, q) == dists[i];
+    free(dists);
+    return ok;
+}
+
+int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+bool sameValues(List *a, List *b)
+{
+    if (a == NULL || b == NULL || listSize(a) != listSize(b))
+        return false;
+    size_t n = listSize(a);
+    void **va = malloc(n * sizeof(void *));
+    void **vb = malloc(n * sizeof(void *));
+    bool ok = n == 0 || (va != NULL && vb != NULL);
+    if (ok && n > 0)
+    {
+        ListIter it;
+        listIterInit(&it, a);
+        for (size_t i = 0; listIterNext(&it, &va[i]); i++)
+            ;
+        listIterInit(&it, b);
+        for (size_t i = 0; listIterNext(&it, &vb[i]); i++)
+            ;
+        qsort(va, n, sizeof(void *), comparePointer);
+        qsort(vb, n, sizeof(void *), comparePointer);
+        for (size_t i = 0; ok && i < n; i++)
+            ok = va[i] == vb[i];
+    }
+    free(va);
+    free(vb);
+    return ok;
+}
+
+int comparePointer(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)*(void *const *)a;
+    uintptr_t y = (uintptr_t)*(void *const *)b;
+    return (x > y) - (x < y);
+}
+
 int main(int argc, char **argv)
 {
 
@@ -124,6 +279,50 @@ int main(int argc, char **argv)
     end = clock();
     printf("Done in %fs\n", ((double)(end - start)) / CLOCKS_PER_SEC);
 
+    if (error)
+        printf("   Warning: there were some errors\n");
+
+    printf("   %zu positive searches in one batch...", nsearch);
+    error = false;
+    Point **lq = malloc(nsearch * sizeof(Point *));
+    size_t *lr = malloc(nsearch * sizeof(size_t));
+    void **lres = malloc(nsearch * sizeof(void *));
+    for (size_t i = 0; i < nsearch; i++)
+    {
+        lr[i] = rand() % npoints;
+        lq[i] = lp[lr[i]];
+    }
+    start = clock();
+    if (!pdctExactSearchBatch(pd, lq, nsearch, lres))
+        error = true;
+    end = clock();
+    printf("Done in %fs\n", ((double)(end - start)) / CLOCKS_PER_SEC);
+    for (size_t i = 0; !error && i < nsearch; i++)
+    {
+        if (lres[i] != lv[lr[i]])
+        {
+            printf("   Error: associated data is wrong\n");
+            error = true;
+        }
+    }
+
+    printf("   %zu positive searches interleaved...", nsearch);
+    start = clock();
+    pdctExactSearchInterleaved(pd, lq, nsearch, lres);
+    end = clock();
+    printf("Done in %fs\n", ((double)(end - start)) / CLOCKS_PER_SEC);
+    for (size_t i = 0; !error && i < nsearch; i++)
+    {
+        if (lres[i] != lv[lr[i]])
+        {
+            printf("   Error: associated data is wrong\n");
+            error = true;
+        }
+    }
+    free(lq);
+    free(lr);
+    free(lres);
+
     if (error)
         printf("   Warning: there were some errors\n");
 
@@ -146,6 +345,160 @@ int main(int argc, char **argv)
     printf("Done in %fs\n", ((double)(end - start)) / CLOCKS_PER_SEC);
     printf("   Average list size: %f\n", avgsize);
 
+    printf("   %zu ball searches into a reused list...", nsearch);
+    List *lball = listNew();
+
+    start = clock();
+    for (size_t i = npoints; i < ntotal; i++)
+    {
+        if (!pdctBallSearchInto(pd, lp[i], radius, lball))
+            error = true;
+    }
+    end = clock();
+    printf("Done in %fs\n", ((double)(end - start)) / CLOCKS_PER_SEC);
+    if (error)
+        printf("   Error: a search into the reused list failed\n");
+    for (size_t i = npoints; !error && i < ntotal && i < npoints + NCHECK; i++)
+    {
+        List *l = pdctBallSearch(pd, lp[i], radius);
+        if (!pdctBallSearchInto(pd, lp[i], radius, lball) ||
+            !sameValues(lball, l))
+        {
+            printf("   Error: the reused list differs from a new one\n");
+            error = true;
+        }
+        if (l != NULL)
+            listFree(l, false);
+    }
+    listFree(lball, false);
+
+    printf("   %zu ball counts of radius %f...", nsearch, radius);
+    avgsize = 0;
+
+    start = clock();
+    for (size_t i = npoints; i < ntotal; i++)
+        avgsize += (double)pdctBallCount(pd, lp[i], radius) / (double)nsearch;
+    end = clock();
+    printf("Done in %fs\n", ((double)(end - start)) / CLOCKS_PER_SEC);
+    printf("   Average count: %f\n", avgsize);
+
+    bool *removed = calloc(ntotal, sizeof(bool));
+    for (size_t i = npoints; !error && i < ntotal && i < npoints + NCHECK; i++)
+    {
+        if (pdctBallCount(pd, lp[i], radius) !=
+            scanBallCount(lp, removed, npoints, lp[i], radius))
+        {
+            printf("   Error: the count is wrong\n");
+            error = true;
+        }
+    }
+    if (error)
+        printf("   Warning: there were some errors\n");
+
+    //****************************
+    // Nearest neighbours searches
+
+    printf("\nTesting nearest neighbours searches:\n");
+    printf("   %zu searches of the %d nearest neighbours...", nsearch, K);
+    error = false;
+
+    start = clock();
+    for (size_t i = npoints; i < ntotal; i++)
+    {
+        List *l = pdctKNearest(pd, lp[i], K);
+        if (l == NULL)
+            error = true;
+        else
+            listFree(l, false);
+    }
+    end = clock();
+    printf("Done in %fs\n", ((double)(end - start)) / CLOCKS_PER_SEC);
+    for (size_t i = npoints; !error && i < ntotal && i < npoints + NCHECK; i++)
+    {
+        List *l = pdctKNearest(pd, lp[i], K);
+        if (!checkKNearest(l, lp, removed, npoints, lp[i], K))
+        {
+            printf("   Error: the neighbours are wrong\n");
+            error = true;
+        }
+        if (l != NULL)
+            listFree(l, false);
+    }
+    if (error)
+        printf("   Warning: there were some errors\n");
+
+    //****************************
+    // Removals
+
+    printf("\nTesting removals:\n");
+    size_t nremove = (nsearch < npoints / 2) ? nsearch : npoints / 2;
+    printf("   %zu removals...", nremove);
+    error = false;
+
+    start = clock();
+    for (size_t i = 0; i < nremove; i++)
+    {
+        size_t rp = 2 * i;
+        if (!pdctRemove(pd, lp[rp], lv[rp]))
+            error = true;
+        removed[rp] = true;
+    }
+    end = clock();
+    printf("Done in %fs\n", ((double)(end - start)) / CLOCKS_PER_SEC);
+    if (error)
+        printf("   Error: one point could not be removed\n");
+    else if (pdctSize(pd) != npoints - nremove)
+    {
+        printf("   Error: the size is wrong\n");
+        error = true;
+    }
+
+    // all the kinds of searches are checked again: the dictionary may have
+    // changed its layout (a frozen BST is thawed by the first removal)
+    void **lbatch = malloc(2 * nremove * sizeof(void *));
+    void **linter = malloc(2 * nremove * sizeof(void *));
+    if (!error && nremove > 0 &&
+        (lbatch == NULL || linter == NULL ||
+         !pdctExactSearchBatch(pd, lp, 2 * nremove, lbatch)))
+    {
+        printf("   Error: the batch search failed after the removals\n");
+        error = true;
+    }
+    if (!error)
+        pdctExactSearchInterleaved(pd, lp, 2 * nremove, linter);
+    for (size_t i = 0; !error && i < 2 * nremove; i++)
+    {
+        void *val = removed[i] ? NULL : lv[i];
+        if (pdctExactSearch(pd, lp[i]) != val || lbatch[i] != val ||
+            linter[i] != val)
+        {
+            printf("   Error: one search is wrong after the removals\n");
+            error = true;
+        }
+    }
+    free(lbatch);
+    free(linter);
+    for (size_t i = npoints; !error && i < ntotal && i < npoints + NCHECK; i++)
+    {
+        size_t count = scanBallCount(lp, removed, npoints, lp[i], radius);
+        List *lb = pdctBallSearch(pd, lp[i], radius);
+        List *l = pdctKNearest(pd, lp[i], K);
+        if (lb == NULL || listSize(lb) != count ||
+            pdctBallCount(pd, lp[i], radius) != count ||
+            !checkKNearest(l, lp, removed, npoints, lp[i], K))
+        {
+            printf("   Error: one search is wrong after the removals\n");
+            error = true;
+        }
+        if (lb != NULL)
+            listFree(lb, false);
+        if (l != NULL)
+            listFree(l, false);
+    }
+    if (error)
+        printf("   Warning: there were some errors\n");
+    free(removed);
+
     pdctFree(pd);
     listFree(lpoints, false);
     listFree(lvalues, false);
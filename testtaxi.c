@@ -263,9 +263,12 @@ int main(int argc, char **argv)
 
     printf("Creating points...");
     List *lpoints = listNew();
-    for (LNode *p = ltrips->head; p != NULL; p = p->next)
+    ListIter it;
+    void *trip;
+    listIterInit(&it, ltrips);
+    while (listIterNext(&it, &trip))
     {
-        Point *newp = transformToXY(((Trip *)p->value)->longitude, ((Trip *)p->value)->latitude);
+        Point *newp = transformToXY(((Trip *)trip)->longitude, ((Trip *)trip)->latitude);
         listInsertLast(lpoints, newp);
     }
     printf("Done\n");
@@ -288,17 +291,20 @@ int main(int argc, char **argv)
         if (listSize(l) > 10)
             printf("First 10 trips:\n");
         int i = 0;
-        for (LNode *p = l->head; p != NULL && i < 10; p = p->next, i++)
+        listIterInit(&it, l);
+        while (i < 10 && listIterNext(&it, &trip))
         {
             printf("  ");
-            printTrip(p->value);
+            printTrip(trip);
+            i++;
         }
     }
 
     listFree(l, false);
     pdctFree(pd);
     listFree(lpoints, true);
-    for (LNode *p = ltrips->head; p != NULL; p = p->next)
-        freeTrip(p->value);
+    listIterInit(&it, ltrips);
+    while (listIterNext(&it, &trip))
+        freeTrip(trip);
     listFree(ltrips, false);
 }